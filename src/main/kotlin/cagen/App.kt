@@ -6,10 +6,12 @@ import cagen.Util.infoln
 import cagen.code.*
 import cagen.draw.Dot
 import cagen.draw.TikzPrinter
+import cagen.expr.SIntegerLiteral
 import com.github.ajalt.clikt.core.*
 import com.github.ajalt.clikt.parameters.arguments.argument
 import com.github.ajalt.clikt.parameters.options.*
 import com.github.ajalt.clikt.parameters.types.file
+import com.github.ajalt.clikt.parameters.types.int
 import java.io.File
 import java.io.PrintWriter
 import java.lang.System
@@ -230,13 +232,22 @@ class Verify : CliktCommand() {
 
 class Rca : CliktCommand() {
     val outputFolder by option("-o", "--output").file().default(File("rca_output"))
+    val maxDfaEntries by option("--max-dfa-entries").int().default(MonitorOptions().maxDfaEntries)
+    val profile by option("--profile", help = "profile written by a monitor built with PROFILE_MONITOR")
+        .file(mustExist = true, canBeDir = false, mustBeReadable = true)
+    val keepClocks by option("--keep-clocks", help = "keep clocks and clock history no guard reads").flag()
+    val keepDeadCode by option("--keep-dead-code", help = "keep transitions that can never fire and unreachable modes").flag()
     val inputFile by argument("SYSTEM")
         .file(mustExist = true, canBeDir = false, mustBeReadable = true)
     val context by requireObject<AppContext>()
 
     override fun run() {
-        val (systems) = context.load(inputFile)
-        systems.forEach{ sys ->
+        val options = MonitorOptions(maxDfaEntries, profile?.let { MonitorProfile.parse(it.readLines()) })
+        val model = context.load(inputFile)
+        val constants = model.globalDefines.mapNotNull { v ->
+            (v.initValue as? SIntegerLiteral)?.let { v.name to it.value.toLong() }
+        }.toMap()
+        model.systems.forEach{ sys ->
             val teName = envClockName(tClockName)
             val tsName = sysClockName(tClockName)
 
@@ -267,7 +278,9 @@ class Rca : CliktCommand() {
                         c.contract.signature.clocks.addLast(Variable(x_s, BuiltInType("int")))
                     }
                 }
-                CppGen.writeRuntimeMonitor(c, outputFolder.toPath())
+                val live = if (keepDeadCode) c.contract else c.contract.pruned(constants)
+                val monitored = c.copy(contract = if (keepClocks) live else live.withoutUnusedClocks())
+                CppGen.writeRuntimeMonitor(monitored, outputFolder.toPath(), options.copy(pruned = live !== c.contract))
             }
             CppGen.writeSystemTu(sys, outputFolder.toPath())
             CppGen.writeSystemHeader(sys, outputFolder.toPath())
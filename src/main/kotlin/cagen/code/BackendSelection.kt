@@ -0,0 +1,108 @@
+package cagen.code
+
+import cagen.Contract
+import java.math.BigInteger
+
+/**
+ * Clock history depth from which tokens share their traces instead of copying them.
+ */
+private const val SHARED_TRACE_DEPTH = 16
+
+/**
+ * Marking size from which the adaptive token container indexes its tokens by hash instead of scanning them.
+ */
+private const val ADAPTIVE_THRESHOLD = 32
+
+/**
+ * Token engine chosen for a contract: the [defines] the monitor header sets unless MANUAL_BACKEND is defined, the
+ * [facts] of the analysis and, for every macro considered, the [reasons] for the choice.
+ */
+data class Backend(
+    val defines: Map<String, String>,
+    val facts: List<Pair<String, String>>,
+    val reasons: Map<String, String>
+) {
+    fun report(contract: Contract): String = buildString {
+        appendLine("Backend of ${contract.name}, define MANUAL_BACKEND to choose the macros by hand")
+        appendLine()
+        facts.forEach { (fact, value) -> appendLine("$fact: $value") }
+        appendLine()
+        reasons.forEach { (macro, reason) ->
+            appendLine("$macro ${if (macro in defines) "defined" else "unset"}: $reason")
+        }
+    }
+}
+
+/**
+ * Tokens a monitor with DEDUPLICATE_TOKENS and EXTRAPOLATE_CLOCKS holds at most: per mode, every clock part of
+ * every kept trace entry is one of `0..k+1` for the largest constant `k` of the clock. `null` if a clock is
+ * compared against variables or expressions.
+ */
+fun Contract.tokenBound(): BigInteger? {
+    val depths = history.toMap()
+    return maxConstants().entries.fold(states.size.toBigInteger()) { bound, (clock, max) ->
+        if (max == null || max.variables.isNotEmpty()) return null
+        val values = (max.constants.maxOrNull() ?: BigInteger.ZERO) + BigInteger.TWO
+        bound * values.pow(2 * (1 + (depths[clock] ?: 0)))
+    }
+}
+
+/**
+ * Chooses the token container and trace storage from the determinism, clock usage and history depth of this.
+ */
+fun Contract.selectBackend(): Backend {
+    val initial = states.filter { it[0].isLowerCase() }
+    val deterministic = initial.size <= 1 && deterministicModes().containsAll(states)
+    val clockless = isClockless()
+    val clockDepth = history.filter { it.first in baseClocks }.maxOfOrNull { it.second } ?: 0
+    val variableDepth = history.filter { it.first !in baseClocks }.maxOfOrNull { it.second } ?: 0
+    val bound = tokenBound()
+    val marking = when {
+        deterministic -> "1 token"
+        clockless -> "${states.size} tokens with DEDUPLICATE_TOKENS, MODE_BITSET or MODE_DFA"
+        bound != null -> "$bound tokens with DEDUPLICATE_TOKENS, unbounded otherwise"
+        else -> "unbounded"
+    }
+    val facts = listOf(
+        "modes" to "${states.size}, initial: ${initial.joinToString()}",
+        "deterministic" to "$deterministic",
+        "clocks" to baseClocks.joinToString().ifEmpty { "none" },
+        "guards read clocks" to "${!clockless}",
+        "clock history depth" to "$clockDepth",
+        "variable history depth" to "$variableDepth",
+        "worst-case marking" to marking,
+    )
+
+    val defines = mutableMapOf<String, String>()
+    val reasons = linkedMapOf<String, String>()
+    reasons["DEDUPLICATE_TOKENS"] = when {
+        deterministic -> "a deterministic contract has at most one token, SINGLE_TOKEN keeps it inline"
+        clockless -> "the successors of a token only depend on its mode, MODE_BITSET or MODE_DFA track the marking"
+        else -> {
+            defines["ADAPTIVE_TOKENS"] = "$ADAPTIVE_THRESHOLD"
+            defines["DEDUPLICATE_TOKENS"] = "1"
+            "tokens of non-deterministic modes multiply, equal tokens are merged" +
+                (bound?.let { " and EXTRAPOLATE_CLOCKS bounds them to $it" } ?: "")
+        }
+    }
+    reasons["ADAPTIVE_TOKENS"] =
+        if ("DEDUPLICATE_TOKENS" !in defines) "only of use together with DEDUPLICATE_TOKENS"
+        else "markings of a few tokens are scanned linearly, bursts beyond $ADAPTIVE_THRESHOLD tokens are hashed"
+    when {
+        baseClocks.isEmpty() -> reasons["RINGBUFFER"] = "the contract has no clocks"
+        clockDepth >= SHARED_TRACE_DEPTH && !deterministic -> {
+            defines["SHARED_TRACES"] = ""
+            reasons["SHARED_TRACES"] = "traces of $clockDepth entries are shared between tokens instead of copied"
+        }
+
+        else -> {
+            defines["RINGBUFFER"] = ""
+            reasons["RINGBUFFER"] = "traces keep at most ${clockDepth + 1} entries, a fixed-size ring buffer " +
+                "is copied without allocation"
+        }
+    }
+    reasons["UNBOUNDED_TRACE"] = "guards read at most $clockDepth past clock values, older ones are only of use " +
+        "for debugging"
+    reasons["FUZZY"] = "changes verdicts to fuzzy truth values, only chosen by hand"
+    return Backend(defines, facts, reasons)
+}
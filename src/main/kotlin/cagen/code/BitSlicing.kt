@@ -0,0 +1,45 @@
+package cagen.code
+
+import cagen.Contract
+import cagen.Variable
+import cagen.expr.*
+import cagen.expr.SBinaryOperator.*
+
+/**
+ * Bitwise C++ expression of the boolean [expr] over `bit_slice` operands, one lane per trace, or `null` if [expr]
+ * reads something other than the boolean variables of the contract.
+ */
+fun Contract.bitSliced(expr: SMVExpr): String? = when {
+    expr is SBooleanLiteral -> if (expr.value) "slice::all()" else "slice{}"
+    expr is SVariable -> expr.name.takeIf { signature.all.any { it.name == expr.name && it.type.name == "bool" } }
+    expr is SUnaryExpression && expr.operator == SUnaryOperator.NEGATE -> bitSliced(expr.expr)?.let { "~$it" }
+    expr is SBinaryExpression -> {
+        val left = bitSliced(expr.left)
+        val right = bitSliced(expr.right)
+        if (left == null || right == null) null
+        else when (expr.operator) {
+            AND -> "($left & $right)"
+            OR -> "($left | $right)"
+            IMPL -> "(~$left | $right)"
+            XOR, NOT_EQUAL -> "($left ^ $right)"
+            XNOR, EQUIV, EQUAL -> "~($left ^ $right)"
+            else -> null
+        }
+    }
+
+    else -> null
+}
+
+/**
+ * Whether every guard is a boolean combination of boolean variables, so that a step of many traces is a fixed
+ * sequence of bitwise operations on their packed values.
+ */
+fun Contract.isBitSliceable(): Boolean =
+    transitions.all { bitSliced(it.contract.pre) != null && bitSliced(it.contract.post) != null }
+
+/**
+ * Variables of the bit-sliced monitor. Integer domains and clocks are not encoded as bit-planes, a sliceable
+ * contract cannot read them, so only the boolean variables are kept.
+ */
+fun Contract.bitSlicedVariables(): List<Variable> =
+    (signature.inputs + signature.outputs + signature.internals).filter { it.type.name == "bool" }
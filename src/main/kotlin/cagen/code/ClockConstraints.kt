@@ -0,0 +1,240 @@
+package cagen.code
+
+import cagen.Contract
+import cagen.expr.*
+import cagen.expr.SBinaryOperator.*
+import java.math.BigInteger
+
+/**
+ * Part of a clock valuation a guard refers to: `x`, `x_e` or `x_s`.
+ */
+enum class ClockPart { TOTAL, ENV, SYS }
+
+data class ClockRef(val clock: String, val part: ClockPart)
+
+/**
+ * Comparison `ref op bound` of a clock against a clock-free expression.
+ * [op] is one of `<`, `<=`, `>` and `>=`.
+ */
+data class ClockAtom(val ref: ClockRef, val op: SBinaryOperator, val bound: SMVExpr)
+
+/**
+ * Conjunction of clock-free [conditions] and clock [atoms]. A guard is represented by a disjunction of terms.
+ */
+data class GuardTerm(val conditions: List<SMVExpr>, val atoms: List<ClockAtom>)
+
+private const val MAX_GUARD_TERMS = 64
+
+private val swapped = mapOf(
+    LESS_THAN to GREATER_THAN, LESS_EQUAL to GREATER_EQUAL,
+    GREATER_THAN to LESS_THAN, GREATER_EQUAL to LESS_EQUAL,
+    EQUAL to EQUAL, NOT_EQUAL to NOT_EQUAL
+)
+
+internal val negated = mapOf(
+    LESS_THAN to GREATER_EQUAL, LESS_EQUAL to GREATER_THAN,
+    GREATER_THAN to LESS_EQUAL, GREATER_EQUAL to LESS_THAN,
+    EQUAL to NOT_EQUAL, NOT_EQUAL to EQUAL
+)
+
+val Contract.baseClocks: List<String>
+    get() = signature.clocks.map { it.name }.filter { !it.isSuffixedClock() }
+
+fun Contract.clockRef(name: String): ClockRef? {
+    for (clock in baseClocks) {
+        when (name) {
+            clock -> return ClockRef(clock, ClockPart.TOTAL)
+            envClockName(clock) -> return ClockRef(clock, ClockPart.ENV)
+            sysClockName(clock) -> return ClockRef(clock, ClockPart.SYS)
+        }
+    }
+    return null
+}
+
+/**
+ * Whether [name] is one of the clock history entries `h_x_i`, `h_x_e_i` or `h_x_s_i`.
+ */
+fun Contract.isClockHistoryAccess(name: String): Boolean = clockRef(name) == null && clockOf(name) != null
+
+fun SMVExpr.variableNames(): Set<String> {
+    val names = mutableSetOf<String>()
+    accept(object : SMVAstScanner() {
+        override fun visit(v: SVariable) {
+            names += v.name
+        }
+
+        override fun visit(func: SFunction) {
+            func.arguments.forEach { it.accept(this) }
+        }
+    })
+    return names
+}
+
+fun Contract.mentionsClock(expr: SMVExpr) =
+    expr.variableNames().any { clockRef(it) != null || isClockHistoryAccess(it) }
+
+fun Contract.mentionsClockHistory(expr: SMVExpr) = expr.variableNames().any { isClockHistoryAccess(it) }
+
+/**
+ * Whether clock history in [expr] is only accessed below unary and binary operators, which are overloaded for
+ * possibly undefined history values. Case expressions and function calls are evaluated by the built-in C++ rules.
+ */
+fun Contract.clockHistoryOnlyInOperators(expr: SMVExpr): Boolean = when (expr) {
+    is SBinaryExpression -> clockHistoryOnlyInOperators(expr.left) && clockHistoryOnlyInOperators(expr.right)
+    is SUnaryExpression -> clockHistoryOnlyInOperators(expr.expr)
+    is SVariable, is SLiteral -> true
+    else -> !mentionsClockHistory(expr)
+}
+
+/**
+ * Whether every guard only accesses clock history below operators, so NOEXCEPT_TRACE_ACCESS is available.
+ */
+fun Contract.clockHistoryOnlyInOperators(): Boolean = transitions.all {
+    clockHistoryOnlyInOperators(it.contract.pre) && clockHistoryOnlyInOperators(it.contract.post)
+}
+
+/**
+ * Guard of [expr] as disjunction of [GuardTerm]s, or `null` if a clock is used outside a comparison
+ * against a clock-free bound (arithmetic over clocks, clock history, case expressions, ...).
+ */
+fun Contract.guardTerms(expr: SMVExpr): List<GuardTerm>? =
+    dnf(expr, true)?.takeIf { it.size <= MAX_GUARD_TERMS }
+
+/**
+ * Guard of [expr] as disjunction of [GuardTerm]s whose conditions are literals: clock-free conditions are split at
+ * the boolean connectives too and comparisons that are no [ClockAtom] are kept as conditions. `null` only if the
+ * guard has more than [MAX_GUARD_TERMS] terms.
+ */
+fun Contract.literalTerms(expr: SMVExpr): List<GuardTerm>? = dnf(expr, true, literals = true)
+
+private fun Contract.dnf(expr: SMVExpr, positive: Boolean, literals: Boolean = false): List<GuardTerm>? {
+    val condition = { listOf(GuardTerm(listOf(if (positive) expr else !expr), listOf())) }
+    if (expr is SBooleanLiteral) {
+        return if (expr.value == positive) listOf(GuardTerm(listOf(), listOf())) else listOf()
+    }
+    if (!literals && !mentionsClock(expr)) return condition()
+    return when (expr) {
+        is SUnaryExpression ->
+            if (expr.operator == SUnaryOperator.NEGATE) dnf(expr.expr, !positive, literals)
+            else if (literals) condition() else null
+
+        is SBinaryExpression -> when (expr.operator) {
+            AND -> if (positive) product(dnf(expr.left, true, literals), dnf(expr.right, true, literals))
+            else union(dnf(expr.left, false, literals), dnf(expr.right, false, literals))
+
+            OR -> if (positive) union(dnf(expr.left, true, literals), dnf(expr.right, true, literals))
+            else product(dnf(expr.left, false, literals), dnf(expr.right, false, literals))
+
+            IMPL -> if (positive) union(dnf(expr.left, false, literals), dnf(expr.right, true, literals))
+            else product(dnf(expr.left, true, literals), dnf(expr.right, false, literals))
+
+            else -> comparisonTerms(expr, positive) ?: if (literals) condition() else null
+        }
+
+        else -> if (literals) condition() else null
+    }
+}
+
+private fun Contract.comparisonTerms(expr: SBinaryExpression, positive: Boolean): List<GuardTerm>? {
+    val op = swapped[expr.operator] ?: return null
+    val (ref, bound, effective) = when {
+        expr.left is SVariable && !mentionsClock(expr.right) ->
+            Triple(clockRef((expr.left as SVariable).name), expr.right, expr.operator)
+
+        expr.right is SVariable && !mentionsClock(expr.left) ->
+            Triple(clockRef((expr.right as SVariable).name), expr.left, op)
+
+        else -> return null
+    }
+    ref ?: return null
+    return when (val o = if (positive) effective else negated.getValue(effective)) {
+        EQUAL -> listOf(GuardTerm(listOf(), listOf(ClockAtom(ref, LESS_EQUAL, bound), ClockAtom(ref, GREATER_EQUAL, bound))))
+        NOT_EQUAL -> listOf(
+            GuardTerm(listOf(), listOf(ClockAtom(ref, LESS_THAN, bound))),
+            GuardTerm(listOf(), listOf(ClockAtom(ref, GREATER_THAN, bound)))
+        )
+
+        else -> listOf(GuardTerm(listOf(), listOf(ClockAtom(ref, o, bound))))
+    }
+}
+
+private fun union(a: List<GuardTerm>?, b: List<GuardTerm>?): List<GuardTerm>? {
+    if (a == null || b == null || a.size + b.size > MAX_GUARD_TERMS) return null
+    return a + b
+}
+
+private fun product(a: List<GuardTerm>?, b: List<GuardTerm>?): List<GuardTerm>? {
+    if (a == null || b == null || a.size * b.size > MAX_GUARD_TERMS) return null
+    return a.flatMap { l -> b.map { r -> GuardTerm(l.conditions + r.conditions, l.atoms + r.atoms) } }
+}
+
+/**
+ * Clock a guard variable belongs to, including the clock history entries.
+ */
+fun Contract.clockOf(name: String): String? = clockRef(name)?.clock
+    ?: baseClocks.firstOrNull { clock ->
+        history.any { (n, depth) ->
+            n == clock && (1..depth).any {
+                name == "h_${clock}_$it" || name == "h_${envClockName(clock)}_$it" || name == "h_${sysClockName(clock)}_$it"
+            }
+        }
+    }
+
+/**
+ * Bounds a clock is compared against: integer [constants] and [variables] whose upper bound is given at compile time.
+ * Once the env and sys part of a clock exceed the largest of them, no guard can distinguish its value anymore.
+ * [diagonal] is set if the difference `x_s = x - x_e` is constrained, which rules out extrapolation of zones.
+ */
+data class MaxConstant(
+    val constants: List<BigInteger> = listOf(),
+    val variables: List<String> = listOf(),
+    val diagonal: Boolean = false
+)
+
+/**
+ * Maximal constants of all clocks, `null` for clocks used outside comparisons against constants or variables.
+ */
+fun Contract.maxConstants(): Map<String, MaxConstant?> {
+    val result = baseClocks.associateWith<String, MaxConstant?> { MaxConstant() }.toMutableMap()
+    for (guard in transitions.flatMap { listOf(it.contract.pre, it.contract.post) }) {
+        val terms = guardTerms(guard)
+        if (terms == null) {
+            guard.variableNames().mapNotNull { clockOf(it) }.forEach { result[it] = null }
+            continue
+        }
+        for (atom in terms.flatMap { it.atoms }) {
+            val current = result[atom.ref.clock] ?: continue
+            val diagonal = current.diagonal || atom.ref.part == ClockPart.SYS
+            result[atom.ref.clock] = when (val bound = atom.bound) {
+                is SIntegerLiteral -> current.copy(constants = current.constants + bound.value, diagonal = diagonal)
+                is SWordLiteral -> current.copy(constants = current.constants + bound.value, diagonal = diagonal)
+                is SVariable -> current.copy(variables = current.variables + bound.name, diagonal = diagonal)
+                else -> null
+            }
+        }
+    }
+    return result
+}
+
+/**
+ * Whether the guards of a step are determined by the variables and the position of each clock relative to its
+ * [maxConstants]: every clock is only compared against constants and variables, and no clock history is kept.
+ * A step with unchanged variables in which no clock passes a bound then fires the same transitions as the last one.
+ */
+fun Contract.skippableSteps(): Boolean = !hasClockHistory() && maxConstants().values.all { it != null }
+
+fun Contract.hasClockHistory(): Boolean = history.any { (name, _) -> name in baseClocks }
+
+/**
+ * Whether no guard reads a clock. The successors of a token then only depend on its mode.
+ */
+fun Contract.isClockless(): Boolean =
+    transitions.none { mentionsClock(it.contract.pre) || mentionsClock(it.contract.post) }
+
+/**
+ * Clock part most preconditions compare against, the key by which tokens are sorted for range queries on
+ * threshold guards. `null` if no precondition has such an atom.
+ */
+fun Contract.indexKey(): ClockRef? =
+    transitions.flatMap { guardTerms(it.contract.pre)?.flatMap { term -> term.atoms } ?: listOf() }
+        .groupingBy { it.ref }.eachCount().maxByOrNull { it.value }?.key
@@ -0,0 +1,57 @@
+package cagen.code
+
+import cagen.CATransition
+import cagen.Contract
+
+/**
+ * Guard variables of all transitions, including the ones disabled by the current version.
+ */
+private fun Contract.guardVariables(): Set<String> =
+    (transitions + disabledTransitions).flatMap {
+        it.contract.pre.variableNames() + it.contract.post.variableNames()
+    }.toSet()
+
+/**
+ * Deepest history entry of every clock read by some guard, 0 if only its current value is read. Clocks that no guard
+ * reads, neither directly, as env or sys part nor through their history, are missing.
+ */
+fun Contract.clockReads(): Map<String, Int> {
+    val reads = mutableMapOf<String, Int>()
+    for (name in guardVariables()) {
+        val clock = clockOf(name) ?: continue
+        val depth = if (clockRef(name) != null) 0 else name.substringAfterLast('_').toInt()
+        reads.merge(clock, depth, ::maxOf)
+    }
+    return reads
+}
+
+/**
+ * Copy of this without the clocks no guard reads. Env and sys variants are kept only if read, resets of removed
+ * clocks are dropped and the history of a clock is cut to the deepest entry a guard accesses. Every token then only
+ * carries and copies the clock traces that can change a verdict.
+ */
+fun Contract.withoutUnusedClocks(): Contract {
+    val reads = clockReads()
+    val names = guardVariables()
+    val clocks = signature.clocks.filter { v ->
+        val ref = clockRef(v.name)
+        when {
+            ref == null -> true
+            ref.part == ClockPart.TOTAL -> ref.clock in reads
+            else -> v.name in names
+        }
+    }
+    val clockHistory = history.mapNotNull { (name, depth) ->
+        when (name) {
+            !in baseClocks -> name to depth
+            in reads -> reads.getValue(name).takeIf { it > 0 }?.let { name to minOf(depth, it) }
+            else -> null
+        }
+    }
+    val prune = { t: CATransition -> t.copy(clocks = t.clocks.filter { it in reads }.toMutableList()) }
+    return copy(
+        signature = signature.copy(clocks = clocks.toMutableList()),
+        history = clockHistory,
+        transitions = transitions.map(prune)
+    ).also { it.disabledTransitions = disabledTransitions.map(prune) }
+}
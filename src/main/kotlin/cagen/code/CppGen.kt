@@ -4,12 +4,47 @@ import cagen.*
 import cagen.code.CCodeUtils.applySubst
 import cagen.code.CCodeUtilsSimplified.toC
 import cagen.code.CCodeUtilsSimplified.toCExpr
+import cagen.expr.SBinaryOperator
 import java.nio.file.Path
 import kotlin.io.path.createFile
 import kotlin.io.path.div
 import kotlin.io.path.exists
 import kotlin.io.path.writeText
 
+/**
+ * Options the monitor of a contract is generated with:
+ * - [maxDfaEntries] is the largest transition table of a determinised monitor, larger ones fall back to the token
+ *   engine,
+ * - [profile] holds the firing counts of a profiling run, transitions of a mode are emitted most frequently fired
+ *   first,
+ * - [pruned] tells that transitions were removed by `pruned()`, which reasons about crisp guards only.
+ */
+data class MonitorOptions(
+    val maxDfaEntries: Int = 1 shl 16,
+    val profile: MonitorProfile? = null,
+    val pruned: Boolean = false,
+)
+
+/**
+ * Monitor of [contract] generated with [options]. The analyses the header, the translation units and the
+ * differential harness share are computed once.
+ */
+class MonitorPlan(val contract: Contract, val options: MonitorOptions = MonitorOptions()) {
+    val backend by lazy { contract.selectBackend() }
+    val deterministicModes by lazy { contract.deterministicModes() }
+    val dfa by lazy { contract.markingDfa(options.maxDfaEntries) }
+
+    //DFA whose predicates only read the variables of the current step, so steps can be evaluated independently
+    val historyFreeDfa by lazy { dfa?.takeIf { contract.history.all { it.first in contract.baseClocks } } }
+
+    //contracts without such a DFA with a single token that never splits: one initial mode, every mode is
+    //deterministic and there is no clock history, so a batch instance is its mode and the current value of its clocks
+    val tokenBatch by lazy {
+        historyFreeDfa == null && !contract.hasClockHistory() && deterministicModes == contract.states &&
+            contract.states.count { it[0].isLowerCase() } == 1
+    }
+}
+
 object CppGen {
     const val headerExtension = ".hpp"
     const val sourceExtension = ".cpp"
@@ -25,28 +60,64 @@ object CppGen {
     }
 
 
-    fun writeRuntimeMonitor(contract: UseContract, folder: Path) {
-        writeMonitorHeader(contract.contract, folder)
+    /**
+     * Writes the monitor of [contract] generated with [options] and its runtime into [folder].
+     */
+    fun writeRuntimeMonitor(contract: UseContract, folder: Path, options: MonitorOptions = MonitorOptions()) {
+        val plan = MonitorPlan(contract.contract, options)
+        writeMonitorHeader(plan, folder)
         writeFuzzyHeader(folder)
         writeFuzzyDefaultImpl(folder)
         writeRingBufferImpl(folder)
-        writeMonitorTu(contract.contract, folder)
-        writeMainTu(contract.contract, contract.variableMap, folder)
+        writeDbmImpl(folder)
+        writeTriValueImpl(folder)
+        writeSharedTraceImpl(folder)
+        writeWorkStealingImpl(folder)
+        writeLruCacheImpl(folder)
+        writeAdaptiveTokensImpl(folder)
+        writeBitSliceImpl(folder)
+        writeCode(folder, "${contract.contract.name}.backend", ".txt", plan.backend.report(contract.contract))
+        writeMonitorTu(plan, folder)
+        writeMainTu(plan, contract.variableMap, folder)
+        writeDifferentialHarness(plan, contract.variableMap, folder)
     }
 
-    fun writeMonitorHeader(contract: Contract, folder: Path) {
+    fun writeMonitorHeader(plan: MonitorPlan, folder: Path) {
+        val contract = plan.contract
         val signature = contract.signature
         val name = contract.name
         val monitorName = getMonitorName(name)
         val modeName = getModeName(name)
         val tokName = getTokenName(name)
         val clockTraceName = getClockValuationTraceName(name)
+        val initialModes = contract.states.filter { it[0].isLowerCase() }
+        val zones = ZoneGen.isSupported(contract)
+        val deterministic = plan.deterministicModes
+        val single = deterministic.isNotEmpty()
+        val skip = contract.skippableSteps()
+        val clockless = contract.isClockless()
+        val dfa = plan.dfa
+        val timestamps = !contract.hasClockHistory()
+        val variables = signature.inputs + signature.outputs + signature.internals
+        val sliced = contract.isBitSliceable()
+        val triHistory = contract.clockHistoryOnlyInOperators()
+        val backend = plan.backend
 
         val code = """
             #pragma once
+            ${if (backend.defines.isNotEmpty()) """
+            //token engine chosen from the analysis in $name.backend.txt, define MANUAL_BACKEND to choose by hand
+            #ifndef MANUAL_BACKEND${backendDefines(backend)}
+            #endif""" else ""}
+            ${if (plan.options.pruned) """
+            //transitions whose crisp guard can never hold were removed, a graded guard may still hold to some degree
+            #ifdef FUZZY
+            #error "transitions were pruned from this monitor, regenerate it with --keep-dead-code to use FUZZY"
+            #endif""" else ""}
 
             #define TRUE true
             #define FALSE false
+            #include <algorithm>
             #include <iostream>
             #include <map>
             #include <vector>
@@ -54,6 +125,13 @@ object CppGen {
             #include <deque>
             #include <string>
             #include <tuple>
+            #include <iterator>
+            #include <array>
+            #include <bitset>
+            #include <cstdint>
+            #include <climits>
+            #include <fstream>
+            #include <unordered_map>
             
             enum class ClockId{
                 ${contract.signature.clocks
@@ -74,6 +152,15 @@ object CppGen {
             	}
             }
             
+            //largest constant a clock part is compared against, bounds of variables are given by MAX_<variable>
+            //-1 if the clock has no such bound
+            [[nodiscard]] constexpr int clock_max_constant(ClockId clock_id) {
+                switch(clock_id){
+                    ${maxConstantCases(contract)}
+                    default: return -1;
+                }
+            }
+            
             #ifndef STOP_ON_EMPTY
             #define STOP_ON_EMPTY 1
             #endif
@@ -83,6 +170,146 @@ object CppGen {
             #ifndef DISPLAY_IOT
             #define DISPLAY_IOT 1
             #endif
+            //deduplicate tokens by a linear scan while there are at most ADAPTIVE_TOKENS of them and through a hash
+            //index above, implies DEDUPLICATE_TOKENS. 0 (default) keeps them in the std::set of DEDUPLICATE_TOKENS
+            #ifndef ADAPTIVE_TOKENS
+            #define ADAPTIVE_TOKENS 0
+            #endif
+            #if(ADAPTIVE_TOKENS)
+            #if defined(DEDUPLICATE_TOKENS) && !(DEDUPLICATE_TOKENS)
+            #error "ADAPTIVE_TOKENS cannot be combined with DEDUPLICATE_TOKENS 0"
+            #endif
+            #ifdef FUZZY
+            #error "ADAPTIVE_TOKENS cannot be combined with FUZZY"
+            #endif
+            #ifndef DEDUPLICATE_TOKENS
+            #define DEDUPLICATE_TOKENS 1
+            #endif
+            #include "adaptive_tokens$headerExtension"
+            #endif
+            ${if (timestamps) """
+            //clocks store the time of their last reset, advance only moves the global time
+            #ifndef TIMESTAMP_CLOCKS
+            #define TIMESTAMP_CLOCKS 0
+            #endif
+            #if(TIMESTAMP_CLOCKS) && (defined(ZONES) || defined(UNBOUNDED_TRACE))
+            #error "TIMESTAMP_CLOCKS cannot be combined with ZONES or UNBOUNDED_TRACE"
+            #endif""" else ""}
+            #ifndef EXTRAPOLATE_CLOCKS
+            #if !defined(FUZZY) && (defined(ZONES) || DEDUPLICATE_TOKENS)${if (timestamps) " && !TIMESTAMP_CLOCKS" else ""}
+            #define EXTRAPOLATE_CLOCKS 1
+            #else
+            #define EXTRAPOLATE_CLOCKS 0
+            #endif
+            #endif
+            #if(EXTRAPOLATE_CLOCKS) && defined(FUZZY)
+            #error "EXTRAPOLATE_CLOCKS cannot be combined with FUZZY"
+            #endif${if (timestamps) """
+            #if(EXTRAPOLATE_CLOCKS) && (TIMESTAMP_CLOCKS)
+            #error "EXTRAPOLATE_CLOCKS cannot be combined with TIMESTAMP_CLOCKS"
+            #endif""" else ""}
+            
+            //token budget, 0 is unlimited
+            #ifndef MAX_TOKENS
+            #define MAX_TOKENS 0
+            #endif
+            #ifndef MAX_TOKEN_BYTES
+            #define MAX_TOKEN_BYTES 0
+            #endif
+            #define OVERFLOW_FAIL_STOP 0
+            #define OVERFLOW_MERGE 1
+            #define OVERFLOW_TRUNCATE 2
+            #ifndef TOKEN_OVERFLOW
+            #define TOKEN_OVERFLOW OVERFLOW_FAIL_STOP
+            #endif
+            #if(TOKEN_OVERFLOW == OVERFLOW_MERGE) && !defined(ZONES)
+            #error "TOKEN_OVERFLOW=OVERFLOW_MERGE requires ZONES"
+            #endif
+            
+            //number of threads evaluating the tokens once there are PARALLEL_THRESHOLD of them, 0 is sequential
+            #ifndef PARALLEL_TOKENS
+            #define PARALLEL_TOKENS 0
+            #endif
+            #ifndef PARALLEL_THRESHOLD
+            #define PARALLEL_THRESHOLD 4096
+            #endif
+            #if(PARALLEL_TOKENS)
+            #if defined(SHARED_TRACES) || defined(ZONES)
+            #error "PARALLEL_TOKENS cannot be combined with SHARED_TRACES or ZONES"
+            #endif
+            #include "work_stealing$headerExtension"
+            #endif
+            
+            //count how often every transition is evaluated, enabled and fired and write the counts to PROFILE_FILE
+            #ifndef PROFILE_MONITOR
+            #define PROFILE_MONITOR 0
+            #endif
+            #if(PROFILE_MONITOR)
+            #if(PARALLEL_TOKENS) || (MEMO_CACHE) || (CLOCK_INDEX) || defined(ZONES)
+            #error "PROFILE_MONITOR cannot be combined with PARALLEL_TOKENS, MEMO_CACHE, CLOCK_INDEX or ZONES"
+            #endif
+            //the mode table, the mode bitset and skipped steps do not count transitions${if (dfa != null) """
+            #ifndef MODE_DFA
+            #define MODE_DFA 0
+            #endif""" else ""}${if (clockless) """
+            #ifndef MODE_BITSET
+            #define MODE_BITSET 0
+            #endif""" else ""}${if (skip) """
+            #ifndef SKIP_UNCHANGED_STEPS
+            #define SKIP_UNCHANGED_STEPS 0
+            #endif""" else ""}
+            #ifndef PROFILE_FILE
+            #define PROFILE_FILE "$name.profile"
+            #endif
+            #endif
+            #if defined(__GNUC__)
+            #define MONITOR_LIKELY(x) __builtin_expect(static_cast<bool>(x), 1)
+            #define MONITOR_UNLIKELY(x) __builtin_expect(static_cast<bool>(x), 0)
+            #else
+            #define MONITOR_LIKELY(x) (x)
+            #define MONITOR_UNLIKELY(x) (x)
+            #endif
+            //the iterations of the loop after it do not depend on each other
+            #if defined(__clang__)
+            #define MONITOR_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+            #elif defined(__GNUC__)
+            #define MONITOR_IVDEP _Pragma("GCC ivdep")
+            #else
+            #define MONITOR_IVDEP
+            #endif
+            ${if (contract.indexKey() != null) """
+            //sort the tokens by mode and the clock most preconditions compare against once there are CLOCK_INDEX of
+            //them, so that threshold guards select the tokens they may enable by binary search. 0 (default) is off
+            #ifndef CLOCK_INDEX
+            #define CLOCK_INDEX 0
+            #endif
+            #if(CLOCK_INDEX) && ((DEDUPLICATE_TOKENS) || defined(ZONES) || defined(FUZZY))
+            #error "CLOCK_INDEX cannot be combined with DEDUPLICATE_TOKENS, ZONES or FUZZY"
+            #endif""" else ""}
+            
+            //number of memoised update steps, 0 disables the cache
+            #ifndef MEMO_CACHE
+            #define MEMO_CACHE 0
+            #endif
+            #if(MEMO_CACHE)
+            #ifdef ZONES
+            #error "MEMO_CACHE cannot be combined with ZONES"
+            #endif
+            #include "lru_cache$headerExtension"
+            #endif${if (sliced) """
+            #include "bit_slice$headerExtension"""" else ""}${if (timestamps) """
+            #if(MEMO_CACHE) && (TIMESTAMP_CLOCKS)
+            #error "MEMO_CACHE cannot be combined with TIMESTAMP_CLOCKS"
+            #endif""" else ""}
+            
+            #ifdef NOEXCEPT_TRACE_ACCESS
+            #ifdef FUZZY
+            #error "NOEXCEPT_TRACE_ACCESS cannot be combined with FUZZY"
+            #endif
+            ${if (triHistory) "" else
+            "#error \"$name accesses clock history inside case expressions or function calls, NOEXCEPT_TRACE_ACCESS is not available\""}
+            #include "tri_value$headerExtension"
+            #endif
             
             #ifdef FUZZY
             #include "q_value$headerExtension"
@@ -93,6 +320,9 @@ object CppGen {
             using Q_Value = bool;
             #endif
             
+            #if defined(RINGBUFFER) && defined(SHARED_TRACES)
+            #error "RINGBUFFER cannot be combined with SHARED_TRACES"
+            #endif
             #ifdef RINGBUFFER
             
             #include "ring_buffer.hpp"
@@ -109,11 +339,66 @@ object CppGen {
             
             template<typename T, int cap>
             using TraceT = ring_buffer<T, cap + 1>;
+            #elif defined(SHARED_TRACES)
+            
+            #include "shared_trace.hpp"
+            
+            template<typename T, std::size_t N>
+            std::ostream& operator<<(std::ostream& out, shared_trace<T,N> const& v) {
+                out << "[";
+                for(std::size_t i = 0; i < v.size(); ++i) {
+                    if(i != 0) out << ",";
+                    out << v[i];
+                }
+                return out << "]";
+            }
+            
+            template<typename T, int cap>
+            #ifdef UNBOUNDED_TRACE
+            using TraceT = shared_trace<T, 0>;
+            #else
+            using TraceT = shared_trace<T, cap>;
+            #endif
             #else
             template<typename T, int cap>
             using TraceT = std::deque<T>;
             #endif
             
+            ${if (timestamps) """#if(TIMESTAMP_CLOCKS)
+            //env and sys time since the start of a monitor, every monitor keeps its own
+            struct clock_epoch {
+                std::int64_t env = 0;
+                std::int64_t sys = 0;
+            };
+            //clocks are read against the epoch of the monitor reading them
+            #define CLOCK_EPOCH epoch
+            
+            //the env and sys time of the last reset, the value is the time passed since
+            template<int clock_id>
+            class ClockVal {
+                std::int64_t _e = 0;
+                std::int64_t _s = 0;
+                public:
+                using value_type = ClockVar<int, clock_id>;
+                
+                ClockVal() noexcept = default;
+                
+                [[nodiscard]] value_type env(clock_epoch const& now) const { return int(now.env - _e); }
+                [[nodiscard]] value_type sys(clock_epoch const& now) const { return int(now.sys - _s); }
+                [[nodiscard]] value_type total(clock_epoch const& now) const { return int(now.env - _e + now.sys - _s); }
+                [[nodiscard]] std::pair<std::int64_t, std::int64_t> reset_time() const { return {_e, _s}; }
+                
+                void reset(clock_epoch const& now) {
+                    _e = now.env;
+                    _s = now.sys;
+                }
+                //advances this clock only, the epoch is moved by the monitor
+                void advance(int t_e, int t_s) {
+                    _e -= t_e;
+                    _s -= t_s;
+                }
+            #else
+            #define CLOCK_EPOCH""" else ""}
             template<int clock_id>
             class ClockVal {
                 int _e{};
@@ -134,8 +419,21 @@ object CppGen {
                 void advance(int t_e, int t_s) {
                     _e += t_e;
                     _s += t_s;
+                    #if(EXTRAPOLATE_CLOCKS)
+                    extrapolate(clock_max_constant((ClockId)clock_id));
+                    #endif
                 }
+                //values above the maximal constant k cannot be distinguished by any guard
+                void extrapolate(int k) {
+                    if(k < 0) return;
+                    _e = std::min(_e, k + 1);
+                    _s = std::min(_s, k + 1);
+                }
+            ${if (timestamps) "#endif" else ""}
                 
+                [[nodiscard]] std::size_t hash() const {
+                    return (std::size_t)_e * 1099511628211u ^ (std::size_t)_s;
+                }
                 //lexicographical comparison for token deduplication
                 [[nodiscard]] bool operator<(ClockVal const& rhs) const {
                     return std::tie(_e, _s) < std::tie(rhs._e, rhs._s);
@@ -145,8 +443,12 @@ object CppGen {
                 }
             };
             template<int clock_id>
-            std::ostream& operator<<(std::ostream& out, ClockVal<clock_id> const& v){
-                return out << "(" << v.env() << "," << v.sys() << ")";
+            std::ostream& operator<<(std::ostream& out, ClockVal<clock_id> const& v){${if (timestamps) """
+                #if(TIMESTAMP_CLOCKS)
+                return out << "(reset at " << v.reset_time().first << "," << v.reset_time().second << ")";
+                #else""" else ""}
+                return out << "(" << v.env() << "," << v.sys() << ")";${if (timestamps) """
+                #endif""" else ""}
             }
             
             struct InvalidTimeAccess{};
@@ -155,6 +457,75 @@ object CppGen {
                 ${contract.states.joinToString(", ")}
             };
             std::ostream& operator<<(std::ostream& out, $modeName v);
+            ${if (single) """
+            #ifndef SINGLE_TOKEN
+            #if !defined(FUZZY) && !defined(ZONES)
+            #define SINGLE_TOKEN 1
+            #else
+            #define SINGLE_TOKEN 0
+            #endif
+            #endif
+            #if(SINGLE_TOKEN) && (defined(FUZZY) || defined(ZONES))
+            #error "SINGLE_TOKEN cannot be combined with FUZZY or ZONES"
+            #endif
+            
+            //modes in which the guards of the outgoing transitions are mutually exclusive
+            [[nodiscard]] constexpr bool is_deterministic($modeName mode) {
+                switch(mode) {
+                    ${deterministic.joinToString("\n                    ") { "case $modeName::$it:" }}
+                        return true;
+                    default:
+                        return false;
+                }
+            }""" else ""}
+            ${if (dfa != null) """
+            #ifndef MODE_DFA
+            #if !defined(FUZZY) && !defined(ZONES)
+            #define MODE_DFA 1
+            #else
+            #define MODE_DFA 0
+            #endif
+            #endif
+            #if(MODE_DFA) && (defined(FUZZY) || defined(ZONES) || (PROFILE_MONITOR))
+            #error "MODE_DFA cannot be combined with FUZZY, ZONES or PROFILE_MONITOR"
+            #endif""" else ""}
+            ${if (clockless) """
+            #ifndef MODE_BITSET
+            #if !defined(FUZZY) && !defined(ZONES)${if (dfa != null) " && !MODE_DFA" else ""}
+            #define MODE_BITSET 1
+            #else
+            #define MODE_BITSET 0
+            #endif
+            #endif
+            #if(MODE_BITSET) && (defined(FUZZY) || defined(ZONES) || (PROFILE_MONITOR))
+            #error "MODE_BITSET cannot be combined with FUZZY, ZONES or PROFILE_MONITOR"
+            #endif${if (dfa != null) """
+            #if(MODE_BITSET) && (MODE_DFA)
+            #error "MODE_BITSET cannot be combined with MODE_DFA"
+            #endif""" else ""}
+            constexpr std::size_t mode_count = ${contract.states.size};""" else ""}
+            ${if (skip) """
+            #ifndef SKIP_UNCHANGED_STEPS
+            #if !defined(FUZZY) && !defined(ZONES) && !TIMESTAMP_CLOCKS
+            #define SKIP_UNCHANGED_STEPS 1
+            #else
+            #define SKIP_UNCHANGED_STEPS 0
+            #endif
+            #endif
+            #if(SKIP_UNCHANGED_STEPS) && (defined(FUZZY) || defined(ZONES) || TIMESTAMP_CLOCKS || (PROFILE_MONITOR))
+            #error "SKIP_UNCHANGED_STEPS cannot be combined with FUZZY, ZONES, TIMESTAMP_CLOCKS or PROFILE_MONITOR"
+            #endif""" else ""}
+            ${if (contract.hasGuardTrees()) """
+            #ifndef GUARD_TREES
+            #ifndef FUZZY
+            #define GUARD_TREES 1
+            #else
+            #define GUARD_TREES 0
+            #endif
+            #endif
+            #if(GUARD_TREES) && defined(FUZZY)
+            #error "GUARD_TREES cannot be combined with FUZZY"
+            #endif""" else ""}
             
             using std::map;
             using std::vector;
@@ -216,13 +587,25 @@ object CppGen {
                     return std::tie(mode, clock_traces) < std::tie(rhs.mode, rhs.clock_traces);
                     #endif
                 }
+                #if(ADAPTIVE_TOKENS) || (MEMO_CACHE)
+                //equal tokens have equal hashes, older trace entries are left out
+                [[nodiscard]] std::size_t hash() const {
+                    std::size_t h = (std::size_t)mode;${contract.baseClocks.joinToString("") { """
+                    h = (h ^ clock_traces.${it}_trace.size()) * 1099511628211u;
+                    h = (h ^ clock_traces.${it}_trace.back().hash()) * 1099511628211u;""" }}
+                    return h;
+                }
+                #endif
             };
             
-            #if(DEDUPLICATE_TOKENS)
+            #if(ADAPTIVE_TOKENS)
+            using ToksT = adaptive_tokens<$tokName, ADAPTIVE_TOKENS>;
+            #elif(DEDUPLICATE_TOKENS)
             using ToksT = std::set<$tokName>;
             #else
             using ToksT = std::vector<$tokName>;
             #endif
+            ${ZoneGen.declarations(contract)}
             
             struct $monitorName {
                 //inputs
@@ -232,7 +615,26 @@ object CppGen {
                 //internals
                 ${signature.internals.declareMembers()}
                 //tokens
+                ${if (zones) """#ifdef ZONES
+                ZoneToksT tokens;
+                #else
                 ToksT tokens;
+                #endif""" else "ToksT tokens;"}
+                ${if (clockless) """#if(MODE_BITSET)
+                //no guard reads a clock, so the marking is the set of modes of the tokens, tokens stays empty
+                std::bitset<mode_count> marking;
+                #endif""" else ""}
+                ${if (dfa != null) """#if(MODE_DFA)
+                //state of the minimal DFA over the markings, tokens stays empty
+                std::size_t dfa_state = 0;
+                #endif""" else ""}
+                ${if (single) """#if(SINGLE_TOKEN)
+                //the only token while it is in a deterministic mode, tokens is empty meanwhile
+                $tokName single_token;
+                bool single = false;
+                #else
+                static constexpr bool single = false;
+                #endif""" else ""}
                 
                 //history${
                     contract.history.filter { contract.signature.clocks.none { v -> v.name == it.first } }.joinToString("") { (name, depth) ->
@@ -248,6 +650,62 @@ object CppGen {
                 
                 bool SYSTEM_LOSES = false;
                 bool ENVIRONMENT_LOSES = false;
+                //the token budget could not be kept, no verdict about the trace
+                bool BUDGET_EXCEEDED = false;
+                ${if (timestamps) """
+                #if(TIMESTAMP_CLOCKS)
+                //time since the start of this monitor, the clocks of its tokens are read against it
+                clock_epoch epoch;
+                #endif""" else ""}
+                
+                std::size_t peak_tokens = 0;
+                std::size_t peak_token_bytes = 0;
+                std::size_t budget_overflows = 0;
+                
+                #if(MEMO_CACHE)
+                //successor marking of a marking under a valuation of the variables and their history, markings are
+                //interned in memo_markings and referred to by id
+                struct MemoStep {
+                    std::size_t marking;
+                    bool any_pre;
+                    bool precondition_accessed_incorrect_time;
+                    bool postcondition_accessed_incorrect_time;
+                    bool stationary;
+                };
+                using MemoKey = std::pair<std::size_t, std::tuple<${memoValuation(contract).joinToString(", ") { "decltype($it)" }}>>;
+                lru_cache<MemoKey, MemoStep, memo_key_hash> memo{MEMO_CACHE};
+                //markings referred to by the entries of memo
+                marking_table<ToksT> memo_markings;
+                #endif
+                ${if (skip) """
+                #if(SKIP_UNCHANGED_STEPS)
+                //variables of the previous step and for how many steps they stayed the same
+                ${(signature.inputs + signature.outputs + signature.internals).declareMembers("_prev")}
+                std::size_t unchanged_steps = 0;
+                //every token took a self-loop without clock resets in the last update
+                bool stationary = false;
+                //a clock passed a guard bound since the last update
+                bool crossed_bound = false;
+                
+                //whether a bound the guards compare the clock against lies between from and to
+                [[nodiscard]] bool crosses_bound(ClockId clock_id, int from, int to) const;
+                //whether advancing the clocks of any token by t_e, t_s crosses a bound
+                [[nodiscard]] bool advance_crosses_bound(int t_e, int t_s) const;
+                #endif
+                
+                template<int clock_id>
+                void advance_clock(ClockVal<clock_id>& clock, int t_e, int t_s) {
+                    #if(SKIP_UNCHANGED_STEPS)
+                    auto const from = clock;
+                    clock.advance(t_e, t_s);
+                    crossed_bound = crossed_bound
+                        || crosses_bound((ClockId)clock_id, from.total(), clock.total())
+                        || crosses_bound((ClockId)clock_id, from.env(), clock.env())
+                        || crosses_bound((ClockId)clock_id, from.sys(), clock.sys());
+                    #else
+                    clock.advance(t_e, t_s);
+                    #endif
+                }""" else ""}
             
                 [[nodiscard]] $monitorName() noexcept {
                     $clockTraceName initial_clock_val;
@@ -256,19 +714,200 @@ object CppGen {
                     .toList().joinToString("") { """
                     initial_clock_val.${it.name}_trace = TraceT<ClockVal<(int)ClockId::${it.name}>, clock_trace_capacity(ClockId::${it.name})>{ClockVal<(int)ClockId::${it.name}>{}};"""}
                     }
-                    tokens = ToksT{${contract.states.filter { it[0].isLowerCase() }.joinToString(", ") { 
+                    ${if (zones) """#ifdef ZONES
+                    tokens = ZoneToksT{${ZoneGen.initialTokens(contract, initialModes)}};
+                    #else""" else ""}
+                    tokens = ToksT{${initialModes.joinToString(", ") { 
                         "$tokName{$modeName::$it, initial_clock_val}"
                     }}};
-                    
+                    ${if (zones) "#endif" else ""}
+                    ${if (clockless) """#if(MODE_BITSET)
+                    for(auto const& tok : tokens) {
+                        marking.set((std::size_t)tok.mode);
+                    }
+                    tokens.clear();
+                    #endif""" else ""}
+                    ${if (dfa != null) """#if(MODE_DFA)
+                    tokens.clear();
+                    #endif""" else ""}
+                    ${if (single) """#if(SINGLE_TOKEN)
+                    $enterSingleToken
+                    #endif""" else ""}
                 }
                 void update();
                 void advance(int t_e, int t_s);
+                //n times advance(t_e, t_s) and update() with the current variables, stops early once should_stop()
+                //holds and returns the number of steps taken
+                std::size_t advance_and_update_n(std::size_t n, int t_e, int t_s);
+                void enforce_budget();
+                [[nodiscard]] bool within_budget() const;
+                //estimated memory of the tokens and their clock traces
+                [[nodiscard]] std::size_t token_bytes() const;
+                //smallest advance t_e + t_s after which a clock guard leaving the mode of a token may change its
+                //truth value for the current variables, -1 if advancing time cannot change any guard
+                [[nodiscard]] int next_deadline() const;
+                #if(PROFILE_MONITOR)
+                struct TransitionCounts {
+                    std::uint64_t visits = 0;
+                    std::uint64_t enabled = 0;
+                    std::uint64_t fired = 0;
+                };
+                //indexed by the position of the transition in the contract
+                std::array<TransitionCounts, ${contract.transitions.size}> profile{};
+                //one line `contract index visits enabled fired` per transition
+                void write_profile(char const* path) const;
+                #endif
+                ${if (dfa != null) """#if(MODE_DFA)
+                //truth vector of the atomic predicates of the guards for the current variables
+                [[nodiscard]] std::size_t predicate_vector() const;
+                //successor of a DFA state under a truth vector and the verdict of a state: 0 running,
+                //1 environment loses, 2 system loses
+                static std::size_t dfa_step(std::size_t state, std::size_t predicates);
+                static int dfa_verdict_of(std::size_t state);
+                static constexpr std::size_t dfa_states = ${dfa.size};
+                #endif""" else ""}
+                #if(PARALLEL_TOKENS)
+                //what the successors of a part of the tokens reported
+                struct StepFlags {
+                    bool any_pre = false;
+                    bool precondition_accessed_incorrect_time = false;
+                    bool postcondition_accessed_incorrect_time = false;
+                    bool stationary = true;
+                };
+                void step_token($tokName tok, ToksT& next_tokens, StepFlags& flags) const;
+                void step_parallel(ToksT& next_tokens, bool& any_pre);
+                #endif${if (contract.indexKey() != null) """
+                #if(CLOCK_INDEX)
+                void step_indexed(ToksT& next_tokens, bool& any_pre);
+                #endif""" else ""}
                 [[nodiscard]] bool should_stop() const;
                 friend std::ostream& operator<<(std::ostream& out, $monitorName const&);
             };
+            ${plan.historyFreeDfa?.let { batch -> """
+            #if(MODE_DFA)
+            //independent instances of the monitor in structure-of-arrays layout, stepped together. An instance is its
+            //variables and its DFA state, the loops over the instances are branch-free so they vectorise across instances.
+            class ${monitorName}Batch {
+            public:
+                explicit ${monitorName}Batch(std::size_t instances);
+                [[nodiscard]] std::size_t size() const { return dfa_state.size(); }
+                
+                //variables of every instance, booleans are stored as bytes
+                ${variables.joinToString("\n                ") { "std::vector<${batchType(it)}> ${it.name};" }}
+                
+                //updates every instance with its current variables
+                void update();
+                //0: running, 1: environment loses, 2: system loses
+                [[nodiscard]] int verdict(std::size_t instance) const;
+                //number of instances with a verdict
+                [[nodiscard]] std::size_t stopped() const;
+            
+            private:
+                std::vector<${dfaEntry(batch)}> dfa_state;
+                std::vector<std::uint16_t> predicates;
+            };
+            #endif""" } ?: ""}${if (plan.tokenBatch) """
+            #ifndef FUZZY
+            //independent instances of the deterministic monitor in structure-of-arrays layout, stepped together. The
+            //single token of an instance never splits, so an instance is its variables, their history, the mode of the
+            //token and the env and sys part of its clocks. The loops over the instances are branch-free.
+            class ${monitorName}Batch {
+            public:
+                explicit ${monitorName}Batch(std::size_t instances);
+                [[nodiscard]] std::size_t size() const { return verdicts.size(); }
+                
+                //variables of every instance, booleans are stored as bytes
+                ${variables.joinToString("\n                ") { "std::vector<${batchType(it)}> ${it.name};" }}
+                
+                //advances the clocks of every instance
+                void advance(int t_e, int t_s);
+                //advances the clocks of one instance
+                void advance(std::size_t instance, int t_e, int t_s);
+                //updates every instance with its current variables
+                void update();
+                //0: running, 1: environment loses, 2: system loses
+                [[nodiscard]] int verdict(std::size_t instance) const;
+                //number of instances with a verdict
+                [[nodiscard]] std::size_t stopped() const;
+            
+            private:
+                std::vector<$modeName> mode;
+                std::vector<std::uint8_t> verdicts;
+                ${contract.baseClocks.joinToString("\n                ") { "std::vector<int> clock_${it}_e, clock_${it}_s;" }}
+                ${variableHistory(contract).joinToString("\n                ") { (v, depth) ->
+                    (0..depth).joinToString(" ") { "std::vector<${batchType(v)}> h_${v.name}_$it;" }
+                }}
+            };
+            #endif""" else ""}
+            ${if (sliced) """
+            //independent traces checked together: lane t of every slice belongs to trace t, so a step of all traces
+            //is a fixed sequence of bitwise operations. Words = 1 checks 64 traces, Words = 4 checks 256.
+            template<std::size_t Words = 1>
+            class ${monitorName}Sliced {
+            public:
+                using slice = bit_slice<Words>;
+                static constexpr std::size_t lanes = slice::lanes;
+                
+                //boolean variables, lane t holds the value in trace t
+                ${contract.bitSlicedVariables().joinToString("\n                ") { "slice ${it.name}{};" }}
+                
+                //updates every trace with its current variables
+                void update() {
+                    slice any_pre{};
+                    ${contract.states.joinToString("\n                    ") { "slice next_$it{};" }}
+                    ${contract.transitions.withIndex().joinToString("\n                    ") { (i, t) ->
+                        "auto const enabled_$i = in_${t.from} & ${contract.bitSliced(t.contract.pre)};\n                    " +
+                        "any_pre |= enabled_$i;\n                    " +
+                        "next_${t.to} |= enabled_$i & ${contract.bitSliced(t.contract.post)};"
+                    }}
+                    ${contract.states.joinToString("\n                    ") { "in_$it = next_$it;" }}
+                    
+                    //traces with a verdict keep it
+                    auto const running = ~(environment_loses | system_loses);
+                    environment_loses |= running & ~any_pre;
+                    system_loses |= running & any_pre & ~(${contract.states.joinToString(" | ") { "in_$it" }});
+                }
+                
+                //0: running, 1: environment loses, 2: system loses
+                [[nodiscard]] int verdict(std::size_t lane) const {
+                    return environment_loses.test(lane) ? 1 : system_loses.test(lane) ? 2 : 0;
+                }
+                //number of traces with a verdict
+                [[nodiscard]] std::size_t stopped() const { return (environment_loses | system_loses).count(); }
+            
+            private:
+                //lanes in which the mode is marked
+                ${contract.states.joinToString("\n                ") {
+                    "slice in_$it = ${if (it[0].isLowerCase()) "slice::all()" else "slice{}"};"
+                }}
+                slice environment_loses{};
+                slice system_loses{};
+            };""" else ""}
             
             enum class ClockKind { env, sys, total };
             
+            #ifdef NOEXCEPT_TRACE_ACCESS
+            //out of bounds access yields an undefined value instead of throwing with ERROR_TRACE_ACCESS and 0 without it
+            template<ClockKind clock_kind, int clock_id>
+            struct ClockHistoryEntry : Tri<int> {
+                using trace_type = TraceT<ClockVal<clock_id>, clock_trace_capacity((ClockId)clock_id)>;
+                
+                [[nodiscard]] ClockHistoryEntry(trace_type const& trace, int depth) noexcept :
+                    Tri<int>{0, depth < trace.size()} {
+                    if(defined) {
+                        auto const& clock = trace[trace.size() - depth - 1];
+                        switch(clock_kind) {
+                            case ClockKind::env: value = clock.env(); break;
+                            case ClockKind::sys: value = clock.sys(); break;
+                            case ClockKind::total: value = clock.total(); break;
+                        }
+                    }
+                    #ifndef ERROR_TRACE_ACCESS
+                    defined = true;
+                    #endif
+                }
+            };
+            #else
             template<ClockKind clock_kind, int clock_id>
             class ClockHistoryEntry {
                 using trace_type = TraceT<ClockVal<clock_id>, clock_trace_capacity((ClockId)clock_id)>; 
@@ -297,18 +936,77 @@ object CppGen {
                 }
             
             };
+            #endif
         """.trimIndent()
         writeCode(folder, contract.name, headerExtension, code)
     }
 
-    fun writeMonitorTu(contract: Contract, folder: Path) {
+    fun writeMonitorTu(plan: MonitorPlan, folder: Path) {
+        val contract = plan.contract
         val name = contract.name
         val monitorName = getMonitorName(name)
-        val tokName = getTokenName(name)
         val modeName = getModeName(name)
+        val tokName = getTokenName(name)
+        val zones = ZoneGen.isSupported(contract)
+        val deterministic = plan.deterministicModes
+        val single = deterministic.isNotEmpty()
+        val skip = contract.skippableSteps()
+        val clockless = contract.isClockless()
+        val dfa = plan.dfa
+        val timestamps = !contract.hasClockHistory()
+        val indexKey = contract.indexKey()
+        val variables = contract.signature.inputs + contract.signature.outputs + contract.signature.internals
+        val historyDepth = contract.history.filter { it.first !in contract.baseClocks }.maxOfOrNull { it.second } ?: 0
+        val advanceClock = { tok: String, clock: String ->
+            if (skip) "advance_clock($tok.clock_traces.${clock}_trace.back(), t_e, t_s);"
+            else "$tok.clock_traces.${clock}_trace.back().advance(t_e, t_s);"
+        }
 
         val code = """
             #include "$name$headerExtension"
+            ${if (dfa != null) """
+            #if(MODE_DFA)${dfaTables(dfa)}
+            
+            std::size_t $monitorName::predicate_vector() const {
+                std::size_t predicates = 0;
+                ${dfa.predicates.withIndex().joinToString("\n                ") { (i, p) ->
+                    "if(${p.toCExpr()}) predicates |= std::size_t{1} << $i;"
+                }}
+                return predicates;
+            }
+            
+            std::size_t $monitorName::dfa_step(std::size_t state, std::size_t predicates) {
+                return dfa_next[state][predicates];
+            }
+            
+            int $monitorName::dfa_verdict_of(std::size_t state) {
+                return dfa_verdict[state];
+            }
+            ${plan.historyFreeDfa?.let { batch -> """
+            ${monitorName}Batch::${monitorName}Batch(std::size_t instances) :${
+                variables.joinToString("") { " ${it.name}(instances)," }} dfa_state(instances), predicates(instances) {}
+            
+            void ${monitorName}Batch::update() {
+                auto const instances = size();
+                for(std::size_t i = 0; i < instances; ++i) {
+                    ${variables.joinToString("\n                    ") { "[[maybe_unused]] auto const ${it.name} = this->${it.name}[i];" }}
+                    predicates[i] = ${batch.predicates.withIndex().joinToString(" | ") { (i, p) ->
+                        "(std::uint16_t(bool(${p.toCExpr()})) << $i)"
+                    }.ifEmpty { "0" }};
+                }
+                for(std::size_t i = 0; i < instances; ++i) {
+                    dfa_state[i] = dfa_next[dfa_state[i]][predicates[i]];
+                }
+            }
+            
+            int ${monitorName}Batch::verdict(std::size_t instance) const {
+                return dfa_verdict[dfa_state[instance]];
+            }
+            
+            std::size_t ${monitorName}Batch::stopped() const {
+                return std::count_if(dfa_state.begin(), dfa_state.end(), [](auto state) { return dfa_verdict[state] != 0; });
+            }""" } ?: ""}
+            #endif""" else ""}${if (plan.tokenBatch) tokenBatchCode(contract) else ""}
             
             std::ostream& operator<<(std::ostream& out, $modeName v) {
                 switch(v) {
@@ -319,14 +1017,32 @@ object CppGen {
             }
             
             void $monitorName::advance(int t_e, int t_s) {
+                #if(DISPLAY_TRACES)
                 std::cout << "Advance monitor by t_e = "<<t_e<<", t_s = "<<t_s<<std::endl;
-                #if(DEDUPLICATE_TOKENS)
+                #endif
+                ${if (timestamps) """#if(TIMESTAMP_CLOCKS)
+                //the clocks of all tokens follow the epoch of this monitor, the marking stays untouched
+                epoch.env += t_e;
+                epoch.sys += t_s;
+                return;
+                #endif""" else ""}
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(single) {
+                    ${contract.baseClocks.joinToString("\n                    ") { advanceClock("single_token", it) }}
+                    return;
+                }
+                #endif""" else ""}
+                ${if (zones) """#ifdef ZONES${ZoneGen.advanceBody(contract)}
+                #elif(DEDUPLICATE_TOKENS)""" else "#if(DEDUPLICATE_TOKENS)"}
                 ToksT next_toks;
+                #if(ADAPTIVE_TOKENS)
+                next_toks.follow(tokens);
+                #endif
                 for(auto tok : tokens) {
                     ${contract.signature.clocks
                     .filter { !it.name.isSuffixedClock() }
                     .joinToString("") {"""
-                    tok.clock_traces.${it.name}_trace.back().advance(t_e, t_s);
+                    ${advanceClock("tok", it.name)}
                     """}}
                     next_toks.insert(std::move(tok));
                 }
@@ -336,7 +1052,7 @@ object CppGen {
                     ${contract.signature.clocks
                     .filter { !it.name.isSuffixedClock() }
                     .joinToString("") {"""
-                    tok.clock_traces.${it.name}_trace.back().advance(t_e, t_s);
+                    ${advanceClock("tok", it.name)}
                     """}}
                 }
                 #endif
@@ -355,118 +1071,146 @@ object CppGen {
                 """
                 }}
                 
+                ${if (dfa != null) """#if(MODE_DFA)${dfaUpdate()}
+                #elif(MODE_BITSET)${bitsetUpdate(contract)}
+                #else""" else if (clockless) """#if(MODE_BITSET)${bitsetUpdate(contract)}
+                #else""" else ""}
+                ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                bool unchanged = ${variables.joinToString(" && ") { "${it.name} == ${it.name}_prev" }.ifEmpty { "true" }};
+                unchanged_steps = unchanged ? unchanged_steps + 1 : 0;
+                ${variables.joinToString("\n                ") { "${it.name}_prev = ${it.name};" }}
+                bool repeated = stationary && !crossed_bound && unchanged_steps > $historyDepth;
+                crossed_bound = false;
+                if(repeated) {
+                    //the guards evaluate as in the last update, every token takes its self-loop again
+                    ${if (single) """#if(SINGLE_TOKEN)
+                    if(single) {
+                        auto& tok = single_token;${repeatSelfLoop(contract)}
+                    }
+                    #endif""" else ""}
+                    #if(DEDUPLICATE_TOKENS)
+                    ToksT next_tokens;
+                    #if(ADAPTIVE_TOKENS)
+                    next_tokens.follow(tokens);
+                    #endif
+                    for(auto tok : tokens) {${repeatSelfLoop(contract)}
+                        next_tokens.insert(std::move(tok));
+                    }
+                    tokens = std::move(next_tokens);
+                    #else
+                    for(auto& tok : tokens) {${repeatSelfLoop(contract)}
+                    }
+                    #endif
+                    #if(MAX_TOKENS || MAX_TOKEN_BYTES)
+                    enforce_budget();
+                    #endif
+                    return;
+                }
+                #endif""" else ""}
+                
                 //update token marking
+                ${if (zones) """#ifdef ZONES${ZoneGen.updateBody(contract)}
+                #else""" else ""}
                 ToksT next_tokens;
+                #if(ADAPTIVE_TOKENS)
+                next_tokens.follow(tokens);
+                #endif
                 bool any_pre = false;
+                ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                stationary = true;
+                #endif""" else ""}
+                #if(MEMO_CACHE)
+                bool const memoize = ${if (single) "!single" else "true"};
+                MemoKey memo_key;
+                MemoStep const* memo_step = nullptr;
+                if(memoize) {
+                    memo_key = MemoKey{memo_markings.intern(tokens), std::make_tuple(${memoValuation(contract).joinToString(", ")})};
+                    memo_step = memo.find(memo_key);
+                }
+                if(memo_step) {
+                    next_tokens = memo_markings[memo_step->marking];
+                    any_pre = memo_step->any_pre;
+                    precondition_accessed_incorrect_time = memo_step->precondition_accessed_incorrect_time;
+                    postcondition_accessed_incorrect_time = memo_step->postcondition_accessed_incorrect_time;
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                    stationary = memo_step->stationary;
+                    #endif""" else ""}
+                } else
+                #endif
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(single) {
+                    auto& tok = single_token;
+                    int successors = 0;
+                    $tokName successor;
+                    ${tokenStep(contract, deterministic, singleInsert, skip, plan.options.profile)}
+                    if(successors == 1 && is_deterministic(successor.mode)) {
+                        single_token = std::move(successor);
+                    } else {
+                        //more than one successor cannot happen in deterministic modes, fall back nevertheless
+                        single = false;
+                        if(successors > 0) {
+                            next_tokens.insert(next_tokens.end(), std::move(successor));
+                        }
+                    }
+                } else {
+                #endif""" else ""}
+                #if(PARALLEL_TOKENS)
+                if(tokens.size() >= PARALLEL_THRESHOLD) {
+                    step_parallel(next_tokens, any_pre);
+                } else
+                #endif${if (indexKey != null) """
+                #if(CLOCK_INDEX)
+                if(tokens.size() >= CLOCK_INDEX) {
+                    step_indexed(next_tokens, any_pre);
+                } else
+                #endif""" else ""}
                 #if(DEDUPLICATE_TOKENS)
                 for(auto tok : tokens) {
                 #else
                 for(auto& tok : tokens) {
                 #endif
-                    ${contract.signature.clocks
-                    .filter { !it.name.isSuffixedClock() }
-                    .joinToString("") {"""
-                    auto ${it.name} = tok.clock_traces.${it.name}_trace.back().total();
-                    auto ${it.name}_e = tok.clock_traces.${it.name}_trace.back().env();
-                    auto ${it.name}_s = tok.clock_traces.${it.name}_trace.back().sys();
-                    """}}
-                    #ifndef RINGBUFFER
-                    #ifndef UNBOUNDED_TRACE
-                    ${contract.signature.clocks.filter {
-                        x -> !x.name.isSuffixedClock() && contract.history.none { it.first == x.name } 
-                    }.joinToString("") { """
-                    if(tok.clock_traces.${it.name}_trace.size() > 1)tok.clock_traces.${it.name}_trace.pop_front();""" }}
-                    #endif
-                    ${contract.history.filter {
-                        !it.first.isSuffixedClock() && contract.signature.clocks.any { v -> v.name == it.first } 
-                    }.joinToString("") { (name, depth) -> """
-                    #ifndef UNBOUNDED_TRACE
-                    if(tok.clock_traces.${name}_trace.size() > $depth + 1)tok.clock_traces.${name}_trace.pop_front();
-                    #endif""" +
-                    (1..depth).joinToString("") {"""
-                    auto h_${name}_${it} = ClockHistoryEntry<ClockKind::total,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
-                    auto h_${envClockName(name)}_${it} = ClockHistoryEntry<ClockKind::env,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
-                    auto h_${sysClockName(name)}_${it} = ClockHistoryEntry<ClockKind::sys,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);"""
-                    }}}
-                    #else
-                    //ring_buffer automatically overrides old values
-                    ${contract.history.filter {
-                        !it.first.isSuffixedClock() && contract.signature.clocks.any { v -> v.name == it.first }
-                    }.joinToString("") { (name, depth) -> 
-                    (1..depth).joinToString("") {"""
-                    auto h_${name}_${it} = ClockHistoryEntry<ClockKind::total,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
-                    auto h_${envClockName(name)}_${it} = ClockHistoryEntry<ClockKind::env,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
-                    auto h_${sysClockName(name)}_${it} = ClockHistoryEntry<ClockKind::sys,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);"""
-                    }}}
-                    #endif
-                    switch(tok.mode) {
-                        ${contract.transitions.groupBy { it.from }.toList().joinToString("""
-                        """) { "case $modeName::${it.first}: {" +
-                        it.second.joinToString("") {
-                            """
-                            try{
-                            Q_Value pre_cond = ${it.contract.pre.toCExpr()};
-                            #ifdef FUZZY
-                            pre_cond = q_combine(tok.q_assume, pre_cond);
-                            #endif
-                            if(pre_cond) {
-                                any_pre = true;
-                                try{
-                                Q_Value post_cond = ${it.contract.post.toCExpr()};
-                                #ifdef FUZZY
-                                post_cond = q_combine(tok.q_guarantee, post_cond);
-                                #endif
-                                if(post_cond) {
-                                    auto new_clock_traces = tok.clock_traces;
-                                    ${contract.signature.clocks
-                                    .filter { !it.name.isSuffixedClock() }
-                                    .joinToString("") {"""
-                                    {
-                                    auto clockvals = &new_clock_traces.${it.name}_trace;
-                                    auto next_clock = clockvals->back();
-                                    clockvals->push_back(std::move(next_clock));
-                                    }
-                                    """}}
-                                    ${it.clocks.joinToString(""){"""
-                                    new_clock_traces.${it}_trace.back().reset();
-                                    """        
-                                    }}
-                                    #ifdef FUZZY
-                                    auto new_tok = $tokName{$modeName::${it.to}, std::move(new_clock_traces), pre_cond, post_cond};
-                                    #else
-                                    auto new_tok = $tokName{$modeName::${it.to}, std::move(new_clock_traces)};
-                                    #endif
-                                    
-                                    #if(DEDUPLICATE_TOKENS)
-                                    next_tokens.insert(std::move(new_tok));
-                                    #else
-                                    next_tokens.emplace_back(std::move(new_tok));
-                                    #endif
-                                }
-                                } catch(InvalidTimeAccess const& time_err) {
-                                    postcondition_accessed_incorrect_time = true;
-                                }
-                            }
-                            } catch(InvalidTimeAccess const& time_err) {
-                                precondition_accessed_incorrect_time = true;
-                            }"""
-                        } + """
-                            break;
-                        };
-                        """ }}
-                    }
+                    ${tokenStep(contract, contract.states, generalInsert, skip, plan.options.profile)}
                 
                 }
+                ${if (single) """#if(SINGLE_TOKEN)
+                }
+                #endif""" else ""}
+                #if(MEMO_CACHE)
+                if(memoize && !memo_step) {
+                    MemoStep step{memo_markings.intern(next_tokens), any_pre, precondition_accessed_incorrect_time, postcondition_accessed_incorrect_time, false};
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                    step.stationary = stationary;
+                    #endif""" else ""}
+                    memo_markings.acquire(memo_key.first);
+                    memo_markings.acquire(step.marking);
+                    if(auto const evicted = memo.insert(std::move(memo_key), std::move(step))) {
+                        memo_markings.release(evicted->first.first);
+                        memo_markings.release(evicted->second.marking);
+                    }
+                }
+                #endif
                 tokens = std::move(next_tokens);
+                ${if (single) """#if(SINGLE_TOKEN)
+                $enterSingleToken
+                #endif""" else ""}
+                ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                stationary = stationary && (!tokens.empty()${if (single) " || single" else ""});
+                #endif""" else ""}
+                ${if (zones) "#endif" else ""}
+                
+                #if(MAX_TOKENS || MAX_TOKEN_BYTES)
+                enforce_budget();
+                #endif
                 
                 //check termination condition if not already terminated 
-                if(!ENVIRONMENT_LOSES && !SYSTEM_LOSES) {
+                if(!ENVIRONMENT_LOSES && !SYSTEM_LOSES && !BUDGET_EXCEEDED) {
                     if(!any_pre) {
                         ENVIRONMENT_LOSES = true;
-                    }else if(tokens.empty()) {
+                    }else if(tokens.empty()${if (single) " && !single" else ""}) {
                         SYSTEM_LOSES = true;
                     }
                 }
+                ${if (clockless) "#endif" else ""}
             }
             
             std::ostream& operator<<(std::ostream& out, $monitorName const& monitor) {
@@ -481,30 +1225,336 @@ object CppGen {
                 ${contract.signature.internals.printVars()}
                 ${if(contract.signature.internals.isNotEmpty()){"""out << '\n';"""}else{""}}
                 //tokens
-                for(auto const& tok : monitor.tokens) {
-                    #ifdef FUZZY
-                    out << "      " << tok.mode << "    ("<<tok.q_assume<<","<<tok.q_guarantee<<")\n";
-                    #else
-                    out << "      " << tok.mode << "\n";
-                    #endif
-                    
-                    ${contract.signature.clocks
-                    .filter { !it.name.isSuffixedClock() }
-                    .joinToString("") {"""
-                    out << "        ${it.name}\n           " << tok.clock_traces.${it.name}_trace << "\n"; 
-                    """
-                    }}
+                ${if (zones) """#ifdef ZONES${ZoneGen.printTokens(contract)}
+                #else""" else ""}
+                ${if (clockless) """#if(MODE_BITSET)
+                for(std::size_t mode = 0; mode < mode_count; ++mode) {
+                    if(monitor.marking[mode]) out << "      " << ($modeName)mode << "\n";
+                }
+                #endif""" else ""}
+                ${if (dfa != null) """#if(MODE_DFA)
+                out << "      dfa state " << monitor.dfa_state << "\n";
+                #endif""" else ""}
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(monitor.single) {
+                    auto const& tok = monitor.single_token;${printToken(contract)}
+                }
+                #endif""" else ""}
+                for(auto const& tok : monitor.tokens) {${printToken(contract)}
                 }
+                ${if (zones) "#endif" else ""}
                 if(monitor.precondition_accessed_incorrect_time)out << "         (precondition accessed incorrect clock history)\n";
                 if(monitor.postcondition_accessed_incorrect_time)out << "         (postcondition accessed incorrect clock history)\n";
                 if(monitor.SYSTEM_LOSES)out << "         (SYSTEM LOSES)\n";
                 if(monitor.ENVIRONMENT_LOSES)out << "         (ENVIRONMENT LOSES)\n";
+                if(monitor.BUDGET_EXCEEDED)out << "         (TOKEN BUDGET EXCEEDED)\n";
+                #if(MAX_TOKENS || MAX_TOKEN_BYTES)
+                out << "         (peak tokens " << monitor.peak_tokens << "/" << MAX_TOKENS
+                    << ", peak bytes " << monitor.peak_token_bytes << "/" << MAX_TOKEN_BYTES
+                    << ", overflows " << monitor.budget_overflows << ")\n";
+                #endif
+                #if(MEMO_CACHE)
+                out << "         (memo hits " << monitor.memo.hits() << ", misses " << monitor.memo.misses() << ")\n";
+                #endif
                 return out;
             }
             
+            std::size_t $monitorName::token_bytes() const {
+                std::size_t bytes = 0;
+                ${if (zones) """#ifdef ZONES
+                bytes += tokens.size() * sizeof(ZoneToksT::value_type);
+                #else""" else ""}
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(single) {
+                    auto const& tok = single_token;
+                    bytes += sizeof(tok);
+                    ${traceBytes(contract)}
+                }
+                #endif""" else ""}
+                for(auto const& tok : tokens) {
+                    bytes += sizeof(tok);
+                    ${traceBytes(contract)}
+                }
+                ${if (zones) "#endif" else ""}
+                return bytes;
+            }
+            
+            bool $monitorName::within_budget() const {
+                return (!MAX_TOKENS || tokens.size()${if (single) " + single" else ""} <= MAX_TOKENS)
+                    && (!MAX_TOKEN_BYTES || token_bytes() <= MAX_TOKEN_BYTES);
+            }
+            
+            void $monitorName::enforce_budget() {
+                peak_tokens = std::max<std::size_t>(peak_tokens, tokens.size()${if (single) " + single" else ""});
+                peak_token_bytes = std::max(peak_token_bytes, token_bytes());
+                if(within_budget()) return;
+                ++budget_overflows;
+                ${if (zones) """#if(TOKEN_OVERFLOW == OVERFLOW_MERGE)
+                //sound over-approximation: one token per mode whose zone contains all zones of that mode
+                ZoneToksT merged;
+                for(auto& tok : tokens) {
+                    auto it = std::find_if(merged.begin(), merged.end(), [&tok](auto const& m) { return m.mode == tok.mode; });
+                    if(it == merged.end()) {
+                        merged.push_back(std::move(tok));
+                    } else {
+                        it->zone.join(tok.zone);
+                    }
+                }
+                tokens = std::move(merged);
+                #endif""" else ""}
+                #if(TOKEN_OVERFLOW == OVERFLOW_TRUNCATE) && !defined(RINGBUFFER) && !defined(ZONES)
+                //drop clock history no guard can access anymore, oldest values first
+                ToksT truncated;
+                #if(ADAPTIVE_TOKENS)
+                truncated.follow(tokens);
+                #endif
+                for(auto tok : tokens) {
+                    ${truncateTraces(contract, "tok")}
+                    truncated.insert(truncated.end(), std::move(tok));
+                }
+                tokens = std::move(truncated);
+                ${if (single) """#if(SINGLE_TOKEN)
+                ${truncateTraces(contract, "single_token")}
+                #endif""" else ""}
+                #endif
+                if(!within_budget()) {
+                    BUDGET_EXCEEDED = true;
+                    tokens.clear();
+                    ${if (single) """#if(SINGLE_TOKEN)
+                    single = false;
+                    #endif""" else ""}
+                }
+            }
+            
+            ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+            bool $monitorName::crosses_bound(ClockId clock_id, int from, int to) const {
+                auto const low = std::min(from, to);
+                auto const high = std::max(from, to);
+                auto within = [low, high](int bound) { return low < high && low <= bound && bound <= high; };
+                switch(clock_id) {
+                    ${crossedBoundCases(contract)}
+                    default: return false;
+                }
+            }
+            
+            bool $monitorName::advance_crosses_bound(int t_e, int t_s) const {
+                auto crosses = [this, t_e, t_s](auto const& tok) {
+                    ${contract.baseClocks.joinToString("
+                    ") { """{
+                    auto const& clock = tok.clock_traces.${it}_trace.back();
+                    if(crosses_bound(ClockId::$it, clock.total(), clock.total() + t_e + t_s)
+                        || crosses_bound(ClockId::$it, clock.env(), clock.env() + t_e)
+                        || crosses_bound(ClockId::$it, clock.sys(), clock.sys() + t_s)) return true;
+                    }""" }}
+                    return false;
+                };
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(single && crosses(single_token)) return true;
+                #endif""" else ""}
+                return std::any_of(tokens.begin(), tokens.end(), crosses);
+            }
+            #endif
+            """ else ""}
+            
+            std::size_t $monitorName::advance_and_update_n(std::size_t n, int t_e, int t_s) {
+                std::size_t steps = 0;
+                ${if (dfa != null) """#if(MODE_DFA)${periodJump("dfa_state", "dfa_states", historyDepth)}
+                #elif(MODE_BITSET)${periodJump("marking", "mode_count", historyDepth)}
+                #endif""" else if (clockless) """#if(MODE_BITSET)${periodJump("marking", "mode_count", historyDepth)}
+                #endif""" else ""}
+                while(steps < n && !should_stop()) {
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS) && !defined(UNBOUNDED_TRACE)
+                    bool unchanged = ${variables.joinToString(" && ") { "${it.name} == ${it.name}_prev" }.ifEmpty { "true" }};
+                    if(unchanged && stationary && unchanged_steps >= $historyDepth) {
+                        //the next steps repeat the last one until a clock crosses a bound, search the last step before
+                        auto const per_step = std::max(1, t_e + t_s);
+                        std::size_t low = 1;
+                        std::size_t high = std::min<std::size_t>(n - steps, INT_MAX / per_step);
+                        while(low < high) {
+                            auto const mid = low + (high - low + 1) / 2;
+                            if(advance_crosses_bound((int)mid * t_e, (int)mid * t_s)) high = mid - 1;
+                            else low = mid;
+                        }
+                        if(low > 1) {
+                            advance((int)low * t_e, (int)low * t_s);
+                            update();
+                            unchanged_steps += low - 1;
+                            steps += low;
+                            continue;
+                        }
+                    }
+                    #endif""" else ""}
+                    advance(t_e, t_s);
+                    update();
+                    ++steps;
+                }
+                return steps;
+            }
+            #if(PARALLEL_TOKENS)
+            //the successors of a copy of tok, the shared state of the monitor is only read
+            void $monitorName::step_token($tokName tok, ToksT& next_tokens, StepFlags& flags) const {
+                bool& any_pre = flags.any_pre;
+                bool& precondition_accessed_incorrect_time = flags.precondition_accessed_incorrect_time;
+                bool& postcondition_accessed_incorrect_time = flags.postcondition_accessed_incorrect_time;
+                ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                bool& stationary = flags.stationary;
+                #endif""" else ""}
+                ${tokenStep(contract, contract.states, generalInsert, skip, plan.options.profile)}
+            }
+            
+            void $monitorName::step_parallel(ToksT& next_tokens, bool& any_pre) {
+                //shared by all monitors, runs are serialized
+                static work_stealing_pool pool{PARALLEL_TOKENS};
+                constexpr std::size_t chunk_size = 256;
+                std::vector<$tokName const*> toks;
+                toks.reserve(tokens.size());
+                for(auto const& tok : tokens) {
+                    toks.push_back(&tok);
+                }
+                auto const chunks = (toks.size() + chunk_size - 1) / chunk_size;
+                //every chunk collects its own successors, merging them in chunk order keeps the sequential order
+                std::vector<ToksT> successors(chunks);
+                std::vector<StepFlags> flags(chunks);
+                pool.run(chunks, [&](std::size_t chunk) {
+                    auto const end = std::min(toks.size(), (chunk + 1) * chunk_size);
+                    for(auto i = chunk * chunk_size; i < end; ++i) {
+                        step_token(*toks[i], successors[chunk], flags[chunk]);
+                    }
+                });
+                for(std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                    #if(DEDUPLICATE_TOKENS)
+                    next_tokens.merge(successors[chunk]);
+                    #else
+                    next_tokens.insert(next_tokens.end(),
+                        std::make_move_iterator(successors[chunk].begin()), std::make_move_iterator(successors[chunk].end()));
+                    #endif
+                    any_pre = any_pre || flags[chunk].any_pre;
+                    precondition_accessed_incorrect_time = precondition_accessed_incorrect_time || flags[chunk].precondition_accessed_incorrect_time;
+                    postcondition_accessed_incorrect_time = postcondition_accessed_incorrect_time || flags[chunk].postcondition_accessed_incorrect_time;
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                    stationary = stationary && flags[chunk].stationary;
+                    #endif""" else ""}
+                }
+            }
+            #endif${indexKey?.let { key -> """
+            #if(CLOCK_INDEX)
+            //sorts a sequence of few ascending runs by merging neighbouring runs
+            template<typename It, typename Less>
+            static void merge_runs(It begin, It end, Less less) {
+                std::vector<It> bounds{begin};
+                for(auto it = begin; it != end;) {
+                    it = std::is_sorted_until(it, end, less);
+                    bounds.push_back(it);
+                }
+                while(bounds.size() > 2) {
+                    std::vector<It> merged{begin};
+                    for(std::size_t i = 2; i < bounds.size(); i += 2) {
+                        std::inplace_merge(bounds[i - 2], bounds[i - 1], bounds[i], less);
+                        merged.push_back(bounds[i]);
+                    }
+                    if(bounds.size() % 2 == 0) merged.push_back(bounds.back());
+                    bounds = std::move(merged);
+                }
+            }
+            
+            //the successors of the tokens sorted by mode and key are emitted in order, so the tokens of the next update
+            //consist of few ascending runs. Tokens outside the windows of all preconditions of their mode enable nothing
+            void $monitorName::step_indexed(ToksT& next_tokens, bool& any_pre) {
+                auto const key = [&]($tokName const& tok) { return ${tracePartBounds(contract, key).first}; };
+                merge_runs(tokens.begin(), tokens.end(), [&key]($tokName const& a, $tokName const& b) {
+                    return a.mode < b.mode || (a.mode == b.mode && key(a) < key(b));
+                });
+                bool skipped = false;
+                std::vector<std::pair<std::size_t, std::size_t>> windows;
+                for(auto mode_begin = tokens.begin(); mode_begin != tokens.end();) {
+                    auto const mode = mode_begin->mode;
+                    auto const mode_end = std::partition_point(mode_begin, tokens.end(), [mode]($tokName const& tok) { return tok.mode == mode; });
+                    //tokens of the mode whose key satisfies the lower and upper bounds of a term of a precondition
+                    auto const window = [&](auto lower, auto upper) {
+                        auto const begin = std::partition_point(mode_begin, mode_end, [&]($tokName const& tok) { return !lower(key(tok)); });
+                        auto const end = std::partition_point(begin, mode_end, [&]($tokName const& tok) { return upper(key(tok)); });
+                        windows.emplace_back(begin - tokens.begin(), end - tokens.begin());
+                    };
+                    windows.clear();
+                    switch(mode) {
+                        ${indexWindows(contract, key)}
+                        default:
+                            break;
+                    }
+                    std::sort(windows.begin(), windows.end());
+                    std::size_t next = mode_begin - tokens.begin();
+                    std::size_t evaluated = 0;
+                    for(auto const& [begin, end] : windows) {
+                        for(auto i = std::max(begin, next); i < end; ++i, ++evaluated) {
+                            auto& tok = tokens[i];
+                            ${tokenStep(contract, contract.states, generalInsert, skip, plan.options.profile)}
+                        }
+                        next = std::max(next, end);
+                    }
+                    skipped = skipped || evaluated < (std::size_t)(mode_end - mode_begin);
+                    mode_begin = mode_end;
+                }${if (skip) """
+                #if(SKIP_UNCHANGED_STEPS)
+                //a skipped token fires no transition, as in the sequential update the step is not stationary
+                stationary = stationary && !skipped;
+                #endif""" else ""}
+            }
+            #endif""" } ?: ""}
+            
+            int $monitorName::next_deadline() const {
+                ${if (!zones) """//$name compares clocks outside of the difference bound fragment, any advance may change a guard
+                return 1;""" else """#ifdef FUZZY
+                //fuzzy guards change with every advance
+                return 1;
+                #else
+                int deadline = -1;
+                //advance after which a part of a clock between low and high reaches bound
+                auto until = [&deadline](int low, int high, int bound) {
+                    int d = high < bound ? bound - high : low <= bound ? 1 : -1;
+                    if(d > 0 && (deadline < 0 || d < deadline)) deadline = d;
+                };
+                #ifdef ZONES
+                for(auto const& tok : tokens) {${deadlineCases(contract) { ZoneGen.partBounds(contract, it) }}
+                }
+                #else
+                ${if (single) """#if(SINGLE_TOKEN)
+                if(single) {
+                    auto const& tok = single_token;${deadlineCases(contract) { tracePartBounds(contract, it) }}
+                }
+                #endif""" else ""}
+                for(auto const& tok : tokens) {${deadlineCases(contract) { tracePartBounds(contract, it) }}
+                }
+                #endif
+                return deadline;
+                #endif"""}
+            }
+            
+            #if(PROFILE_MONITOR)
+            void $monitorName::write_profile(char const* path) const {
+                std::ofstream file(path);
+                file << "# contract transitions index visits enabled fired\n";
+                for(std::size_t i = 0; i < profile.size(); ++i) {
+                    file << "$name " << profile.size() << ' ' << i << ' ' << profile[i].visits << ' ' << profile[i].enabled << ' ' << profile[i].fired << '\n';
+                }
+            }
+            #endif
+            
             bool $monitorName::should_stop() const {
+                if(BUDGET_EXCEEDED) {
+                    return true;
+                }
                 #if(STOP_ON_EMPTY)
-                if(tokens.empty()){
+                ${if (clockless) """#if(MODE_BITSET)
+                if(marking.none()) {
+                    return true;
+                }
+                #endif""" else ""}
+                ${if (dfa != null) """#if(MODE_DFA)
+                if(dfa_verdict[dfa_state] != 0) {
+                    return true;
+                }
+                #endif""" else ""}
+                if(tokens.empty()${if (single) " && !single" else ""}${if (clockless) " && !MODE_BITSET" else ""}${if (dfa != null) " && !MODE_DFA" else ""}){
                     return true;
                 }
                 #endif
@@ -515,13 +1565,15 @@ object CppGen {
         writeCode(folder, contract.name, sourceExtension, code)
     }
 
-    fun writeMainTu(contract: Contract, variableMap: MutableList<Pair<String, IOPort>>, folder: Path) {
-
+    fun writeMainTu(plan: MonitorPlan, variableMap: MutableList<Pair<String, IOPort>>, folder: Path) {
+        val contract = plan.contract
         val name = contract.name
         val monitorName = getMonitorName(name)
         val tokName = getTokenName(name)
         val modeName = getModeName(name)
+        val dfa = plan.historyFreeDfa
         val code = """ 
+                #include <algorithm>
                 #include <cstdlib>
                 #include <cstdio>
                 #include <cstring>
@@ -544,6 +1596,19 @@ object CppGen {
                 #define MONITOR_RATE 100
                 #endif
                 #define EXIT(code) {std::cerr << "EXIT line " << __LINE__ << " with code " << code << std::endl;fflush(0);exit(code);}
+                ${if (dfa != null) """
+                #if(MODE_DFA)
+                #include "work_stealing$headerExtension"
+                
+                //threads of the offline check, 0 (default) uses all hardware threads
+                #ifndef OFFLINE_THREADS
+                #define OFFLINE_THREADS 0
+                #endif
+                //lines of the trace read and checked at once
+                #ifndef OFFLINE_BLOCK
+                #define OFFLINE_BLOCK (1 << 16)
+                #endif
+                #endif""" else ""}
                 
                 std::vector<std::string> split(std::string const& str, char delimiter) {
                     std::vector<std::string> words;
@@ -555,6 +1620,25 @@ object CppGen {
                     return words;
                 }
                 
+                std::map<std::string, std::string> parse_kvs(std::string const& line) {
+                    std::vector<std::string> assignments = split(line, ',');
+                    std::map<std::string, std::string> kvs;
+            
+                    for (const std::string& assignment : assignments) {
+                        auto kv = split(assignment, '=');
+                        assert(kv.size() == 2);
+                        kvs[kv[0]] = kv[1];
+                    }    
+                    
+                    //variableMap
+                    ${
+                        variableMap.joinToString("") { (dest, src) -> """
+                            kvs["$dest"] = kvs["${applySubst(src)}"];"""
+                        }
+                    }
+                    return kvs;
+                }
+                
                 std::map<std::string, std::string> read_kvs(char const* filename) {
                     static int last_read_pos = 0;
 
@@ -579,23 +1663,119 @@ object CppGen {
                         std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_RATE));
                         #endif
                     }
-                    std::vector<std::string> assignments = split(line, ',');
-                    std::map<std::string, std::string> kvs;
-            
-                    for (const std::string& assignment : assignments) {
-                        auto kv = split(assignment, '=');
-                        assert(kv.size() == 2);
-                        kvs[kv[0]] = kv[1];
-                    }    
-                    
-                    //variableMap
-                    ${
-                        variableMap.joinToString("") { (dest, src) -> """
-                            kvs["$dest"] = kvs["${applySubst(src)}"];"""
+                    return parse_kvs(line);
+                }
+                
+                //number of steps a line of the trace stands for, a run-length encoded line repeats its step repeat >= 1 times
+                unsigned long long repeat_of(std::map<std::string, std::string>& kvs) {
+                    if(!kvs.count("repeat")) return 1;
+                    auto const repeat = std::stoll(kvs["repeat"]);
+                    if(repeat < 1) {
+                        std::cerr << "repeat must be at least 1: " << kvs["repeat"] << std::endl;
+                        EXIT(EXIT_FAILURE);
+                    }
+                    return repeat;
+                }
+                ${if (dfa != null) """
+                #if(MODE_DFA)
+                //a step of the trace: truth vector of the atomic predicates and number of repetitions
+                struct offline_step {
+                    std::size_t predicates;
+                    unsigned long long repeat;
+                };
+                
+                //function over the DFA states of a step repeated repeat times, by squaring
+                std::vector<std::size_t> repeated_step(std::size_t predicates, unsigned long long repeat) {
+                    std::vector<std::size_t> result($monitorName::dfa_states);
+                    std::vector<std::size_t> power($monitorName::dfa_states);
+                    for(std::size_t s = 0; s < $monitorName::dfa_states; ++s) {
+                        result[s] = s;
+                        power[s] = $monitorName::dfa_step(s, predicates);
+                    }
+                    for(; repeat > 0; repeat >>= 1) {
+                        if(repeat & 1) {
+                            for(auto& s : result) s = power[s];
                         }
+                        auto squared = power;
+                        for(auto& s : squared) s = power[s];
+                        power = std::move(squared);
                     }
-                    return kvs;
+                    return result;
+                }
+                
+                //checks a complete trace file: every block of lines is cut into chunks which are mapped in parallel to
+                //their function over the DFA states, starting from any state. Applying the functions in trace order
+                //gives the state after every chunk, only the chunk reaching a verdict is replayed step by step.
+                int check_offline(char const* filename) {
+                    std::ifstream file(filename);
+                    if (!file.is_open()) {
+                        std::cerr << "Error opening file: " << std::string(filename) << std::endl;
+                        EXIT(EXIT_FAILURE);
+                    }
+                    static work_stealing_pool pool{OFFLINE_THREADS > 0 ? OFFLINE_THREADS : std::max(1u, std::thread::hardware_concurrency())};
+                    auto const chunks = 4 * pool.size();
+                    std::vector<std::string> lines;
+                    std::vector<std::vector<offline_step>> steps(chunks);
+                    std::vector<std::vector<std::size_t>> functions(chunks);
+                    std::size_t state = 0;
+                    unsigned long long step = 0;
+                    while(true) {
+                        lines.clear();
+                        std::string line;
+                        while(lines.size() < OFFLINE_BLOCK && std::getline(file, line)) {
+                            if(!line.empty()) lines.push_back(std::move(line));
+                        }
+                        if(lines.empty()) break;
+                        auto const chunk_size = (lines.size() + chunks - 1) / chunks;
+                        pool.run(chunks, [&](std::size_t chunk) {
+                            $monitorName monitor;
+                            auto& function = functions[chunk];
+                            function.resize($monitorName::dfa_states);
+                            for(std::size_t s = 0; s < function.size(); ++s) function[s] = s;
+                            steps[chunk].clear();
+                            auto const end = std::min(lines.size(), (chunk + 1) * chunk_size);
+                            for(auto i = chunk * chunk_size; i < end; ++i) {
+                                auto kvs = parse_kvs(lines[i]);
+                                ${contract.signature.inputs.readVars()}
+                                ${contract.signature.outputs.readVars()}
+                                ${contract.signature.internals.readVars()}
+                                offline_step next{monitor.predicate_vector(), repeat_of(kvs)};
+                                if(next.repeat == 1) {
+                                    for(auto& s : function) s = $monitorName::dfa_step(s, next.predicates);
+                                } else {
+                                    auto repeated = repeated_step(next.predicates, next.repeat);
+                                    for(auto& s : function) s = repeated[s];
+                                }
+                                steps[chunk].push_back(next);
+                            }
+                        });
+                        for(std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                            if($monitorName::dfa_verdict_of(functions[chunk][state]) == 0) {
+                                state = functions[chunk][state];
+                                for(auto const& s : steps[chunk]) step += s.repeat;
+                                continue;
+                            }
+                            for(auto const& s : steps[chunk]) {
+                                //a repeated step either enters a sink within dfa_states repetitions or never
+                                auto const direct = std::min<unsigned long long>(s.repeat, $monitorName::dfa_states);
+                                for(unsigned long long i = 0; i < direct; ++i) {
+                                    ++step;
+                                    state = $monitorName::dfa_step(state, s.predicates);
+                                    if(auto verdict = $monitorName::dfa_verdict_of(state)) {
+                                        std::cout << (verdict == 1 ? "ENVIRONMENT" : "SYSTEM") << " LOSES at step " << step << std::endl;
+                                        return 0;
+                                    }
+                                }
+                                state = repeated_step(s.predicates, s.repeat - direct)[state];
+                                step += s.repeat - direct;
+                            }
+                        }
+                    }
+                    std::cout << "no verdict after " << step << " steps" << std::endl;
+                    return 0;
                 }
+                #endif""" else ""}
+                                
                                 
                 int main(int argc, char *argv[]) {
                     if (argc < 2) {
@@ -603,6 +1783,11 @@ object CppGen {
                         EXIT(EXIT_FAILURE);
                     }
                     auto filename = argv[1];
+                    ${if (dfa != null) """#if(MODE_DFA)
+                    if (argc > 2 && std::strcmp(argv[2], "--offline") == 0) {
+                        return check_offline(filename);
+                    }
+                    #endif""" else ""}
                     
                     $monitorName monitor;
                     
@@ -610,6 +1795,7 @@ object CppGen {
                     while (true) {
                         ++iteration;
                         auto kvs = read_kvs(filename);
+                        auto const repeat = repeat_of(kvs);
                         std::cout << "------------------------------------------------------- ["<<iteration<<"]\n";
                         #if(DISPLAY_IOT)
                         for (const auto& kv : kvs) {
@@ -632,21 +1818,353 @@ object CppGen {
                         //process
                         monitor.update();
                         
+                        //a run-length encoded step is repeated with the same valuation
+                        if(repeat > 1 && !monitor.should_stop()) {
+                            iteration += monitor.advance_and_update_n(repeat - 1, te, ts);
+                        }
+                        
                         #if(DISPLAY_TRACES)
                         std::cout << monitor << '\n' << std::endl;
                         #endif
                         
+                        #if(PROFILE_MONITOR)
+                        //the monitor usually runs until it is killed, keep the profile on disk up to date
+                        if(iteration % 1024 == 0) {
+                            monitor.write_profile(PROFILE_FILE);
+                        }
+                        #endif
+                        
                         //check exit condition. default configuration uses `STOP_ON_EMPTY' definition
                         if(monitor.should_stop()){
                             break;
                         }
                     }
-                    
+                    #if(PROFILE_MONITOR)
+                    monitor.write_profile(PROFILE_FILE);
+                    #endif
                 }
                 """.trimIndent()
         writeCode(folder, contract.name+"_monitor", sourceExtension, code)
     }
 
+    /**
+     * Writes the differential harness of [contract]: `<Name>_variant.cpp` compiles the monitor with the macros of one
+     * [engineVariants] entry into its own namespace, `<Name>_differential.cpp` replays traces through all of them in
+     * lockstep and `<Name>_differential.mk` builds it.
+     */
+    fun writeDifferentialHarness(plan: MonitorPlan, variableMap: MutableList<Pair<String, IOPort>>, folder: Path) {
+        val contract = plan.contract
+        val name = contract.name
+        val engineName = "${name}Engine"
+        val modeName = getModeName(name)
+        val variants = plan.engineVariants()
+        val header = """
+            #pragma once
+            #include <algorithm>
+            #include <array>
+            #include <bitset>
+            #include <cassert>
+            #include <chrono>
+            #include <climits>
+            #include <condition_variable>
+            #include <cstddef>
+            #include <cstdint>
+            #include <cstdio>
+            #include <cstdlib>
+            #include <cstring>
+            #include <deque>
+            #include <fstream>
+            #include <functional>
+            #include <initializer_list>
+            #include <iomanip>
+            #include <iostream>
+            #include <iterator>
+            #include <list>
+            #include <map>
+            #include <memory>
+            #include <mutex>
+            #include <new>
+            #include <optional>
+            #include <set>
+            #include <sstream>
+            #include <string>
+            #include <thread>
+            #include <tuple>
+            #include <type_traits>
+            #include <unordered_map>
+            #include <utility>
+            #include <vector>
+            
+            //the standard headers are included here once, the monitor of every variant is compiled into a namespace
+            
+            //monitor of one engine variant, see ${name}_variant$sourceExtension
+            struct $engineName {
+                virtual ~$engineName() = default;
+                //advances the clocks and updates the monitor by one line of a trace
+                virtual void step(std::map<std::string, std::string>& kvs) = 0;
+                [[nodiscard]] virtual bool system_loses() const = 0;
+                [[nodiscard]] virtual bool environment_loses() const = 0;
+                [[nodiscard]] virtual bool should_stop() const = 0;
+                //modes of the tokens, false if the variant only keeps the marking as a DFA state
+                virtual bool modes(std::set<std::string>& modes) const = 0;
+                virtual void print(std::ostream& out) const = 0;
+            };
+            """.trimIndent()
+        writeCode(folder, name + "_differential", headerExtension, header)
+
+        val dfa = plan.dfa
+        val single = plan.deterministicModes.isNotEmpty()
+        val variant = """
+            //one engine variant of the monitor in ${name}_differential, compiled with the macros of the variant and
+            //MONITOR_VARIANT naming its namespace
+            #include "${name}_differential$headerExtension"
+            
+            #ifndef MONITOR_VARIANT
+            #error "MONITOR_VARIANT must name the namespace of the engine variant"
+            #endif
+            
+            namespace MONITOR_VARIANT {
+            #include "$name$sourceExtension"
+            
+            struct engine final : $engineName {
+                ${getMonitorName(name)} monitor;
+                
+                void step(std::map<std::string, std::string>& kvs) override {
+                    auto te = std::stoi(kvs["${envClockName(tClockName)}"]);
+                    auto ts = std::stoi(kvs["${sysClockName(tClockName)}"]);
+                    monitor.advance(te, ts);
+                    ${contract.signature.inputs.readVars()}
+                    ${contract.signature.outputs.readVars()}
+                    ${contract.signature.internals.readVars()}
+                    monitor.update();
+                    //the harness rejects lines with repeat < 1
+                    auto const repeat = kvs.count("repeat") ? std::stoull(kvs["repeat"]) : 1;
+                    if(repeat > 1 && !monitor.should_stop()) {
+                        monitor.advance_and_update_n(repeat - 1, te, ts);
+                    }
+                }
+                
+                [[nodiscard]] bool system_loses() const override { return monitor.SYSTEM_LOSES; }
+                [[nodiscard]] bool environment_loses() const override { return monitor.ENVIRONMENT_LOSES; }
+                [[nodiscard]] bool should_stop() const override { return monitor.should_stop(); }
+                
+                bool modes(std::set<std::string>& modes) const override {
+                    auto insert = [&modes]($modeName mode) {
+                        std::ostringstream out;
+                        out << mode;
+                        modes.insert(out.str());
+                    };
+                    ${if (dfa != null) """#if(MODE_DFA)
+                    return false;
+                    #endif""" else ""}
+                    ${if (contract.isClockless()) """#if(MODE_BITSET)
+                    for(std::size_t mode = 0; mode < mode_count; ++mode) {
+                        if(monitor.marking[mode]) insert(($modeName)mode);
+                    }
+                    #endif""" else ""}
+                    ${if (single) """#if(SINGLE_TOKEN)
+                    if(monitor.single) insert(monitor.single_token.mode);
+                    #endif""" else ""}
+                    for(auto const& tok : monitor.tokens) {
+                        insert(tok.mode);
+                    }
+                    return true;
+                }
+                
+                void print(std::ostream& out) const override { out << monitor; }
+            };
+            
+            std::unique_ptr<$engineName> make_engine() { return std::make_unique<engine>(); }
+            }
+            """.trimIndent()
+        writeCode(folder, name + "_variant", sourceExtension, variant)
+
+        val harness = """
+            //replays traces through every engine variant of the $name monitor in lockstep and compares the verdicts,
+            //the stop condition and the token modes of every variant after every step with its reference. a second
+            //instance of every variant replays the traces one line behind the first and is compared with the second
+            //instance of the reference, so state shared between instances makes it diverge.
+            //reports the first diverging step of every variant and the throughput of all of them.
+            //build with make -f ${name}_differential.mk, run with the trace files as arguments
+            #include "${name}_differential$headerExtension"
+            
+            #define EXIT(code) {std::cerr << "EXIT line " << __LINE__ << " with code " << code << std::endl;fflush(0);exit(code);}
+            
+            ${variants.joinToString("\n            ") { "namespace ${it.name} { std::unique_ptr<$engineName> make_engine(); }" }}
+            
+            struct variant_run {
+                char const* name;
+                std::unique_ptr<$engineName> (*make)();
+                //index of the run this one is compared with, its own for a reference
+                std::size_t reference;
+                std::unique_ptr<$engineName> engine;
+                //second instance, one line behind engine
+                std::unique_ptr<$engineName> lagging;
+                std::chrono::steady_clock::duration time{};
+                unsigned long long steps = 0;
+                //trace and step of the first divergence from the reference, empty if there is none
+                std::string divergence;
+            };
+            
+            std::vector<std::string> split(std::string const& str, char delimiter) {
+                std::vector<std::string> words;
+                std::string word;
+                std::istringstream word_stream(str);
+                while (std::getline(word_stream, word, delimiter)) {
+                    words.push_back(std::move(word));
+                }
+                return words;
+            }
+            
+            std::map<std::string, std::string> parse_kvs(std::string const& line) {
+                std::map<std::string, std::string> kvs;
+                for (const std::string& assignment : split(line, ',')) {
+                    auto kv = split(assignment, '=');
+                    assert(kv.size() == 2);
+                    kvs[kv[0]] = kv[1];
+                }
+                //variableMap
+                ${variableMap.joinToString("") { (dest, src) -> """
+                kvs["$dest"] = kvs["${applySubst(src)}"];"""
+                }}
+                return kvs;
+            }
+            
+            //verdicts, stop condition and, if given, token modes of an engine
+            std::string describe($engineName const& engine, std::set<std::string> const* modes) {
+                std::ostringstream out;
+                out << "SYSTEM_LOSES " << engine.system_loses() << ", ENVIRONMENT_LOSES " << engine.environment_loses()
+                    << ", stop " << engine.should_stop();
+                if(modes) {
+                    out << ", modes {";
+                    for(auto it = modes->begin(); it != modes->end(); ++it) {
+                        out << (it == modes->begin() ? "" : ", ") << *it;
+                    }
+                    out << "}";
+                }
+                return out.str();
+            }
+            
+            int main(int argc, char *argv[]) {
+                if (argc < 2) {
+                    std::cerr << "Did not specify trace files to replay" << std::endl;
+                    EXIT(EXIT_FAILURE);
+                }
+                std::vector<variant_run> runs;
+                ${variants.withIndex().joinToString("\n                ") { (i, v) ->
+                    val reference = variants.indexOfFirst { it.name == v.reference }.takeIf { it >= 0 } ?: i
+                    "runs.push_back(variant_run{\"${v.name.removePrefix("variant_")}\", &${v.name}::make_engine, $reference});"
+                }}
+                
+                bool diverged = false;
+                //compares the first or second instance of every variant with that of its reference after a step
+                auto compare = [&](bool lagging, char const* trace, unsigned long long step) {
+                    for(std::size_t i = 0; i < runs.size(); ++i) {
+                        auto& run = runs[i];
+                        if(run.reference == i || !run.divergence.empty()) continue;
+                        auto const& reference_run = runs[run.reference];
+                        auto const& reference = lagging ? *reference_run.lagging : *reference_run.engine;
+                        auto const& engine = lagging ? *run.lagging : *run.engine;
+                        std::set<std::string> expected_modes, actual_modes;
+                        bool const observable = reference.modes(expected_modes) && engine.modes(actual_modes);
+                        auto const expected = describe(reference, observable ? &expected_modes : nullptr);
+                        auto const actual = describe(engine, observable ? &actual_modes : nullptr);
+                        if(expected == actual) continue;
+                        diverged = true;
+                        char const* const instance = lagging ? " (second instance)" : "";
+                        run.divergence = std::string(trace) + ":" + std::to_string(step) + instance;
+                        std::cout << run.name << instance << " diverges from " << reference_run.name << " at step "
+                            << step << " of " << trace << "\n"
+                            << "  " << reference_run.name << ": " << expected << "\n"
+                            << "  " << run.name << ": " << actual << "\n";
+                        reference.print(std::cout);
+                        engine.print(std::cout);
+                        std::cout << std::endl;
+                    }
+                };
+                for(int arg = 1; arg < argc; ++arg) {
+                    std::ifstream file(argv[arg]);
+                    if (!file.is_open()) {
+                        std::cerr << "Error opening file: " << std::string(argv[arg]) << std::endl;
+                        EXIT(EXIT_FAILURE);
+                    }
+                    for(auto& run : runs) {
+                        run.engine = run.make();
+                        run.lagging = run.make();
+                    }
+                    //line the second instances step next
+                    std::optional<std::map<std::string, std::string>> previous;
+                    auto step_lagging = [&]() {
+                        for(auto& run : runs) {
+                            if(run.lagging->should_stop()) continue;
+                            auto step_kvs = *previous;
+                            run.lagging->step(step_kvs);
+                        }
+                    };
+                    unsigned long long step = 0;
+                    std::string line;
+                    while(std::getline(file, line)) {
+                        if(line.empty()) continue;
+                        ++step;
+                        auto const kvs = parse_kvs(line);
+                        if(kvs.count("repeat") && std::stoll(kvs.at("repeat")) < 1) {
+                            std::cerr << "repeat must be at least 1 in line " << step << " of " << argv[arg] << std::endl;
+                            EXIT(EXIT_FAILURE);
+                        }
+                        if(previous) {
+                            step_lagging();
+                            compare(true, argv[arg], step - 1);
+                        }
+                        bool running = false;
+                        for(auto& run : runs) {
+                            if(run.engine->should_stop()) continue;
+                            auto step_kvs = kvs;
+                            auto const start = std::chrono::steady_clock::now();
+                            run.engine->step(step_kvs);
+                            run.time += std::chrono::steady_clock::now() - start;
+                            ++run.steps;
+                            running = true;
+                        }
+                        compare(false, argv[arg], step);
+                        previous = kvs;
+                        if(!running) break;
+                    }
+                    if(previous) {
+                        step_lagging();
+                        compare(true, argv[arg], step);
+                    }
+                }
+                
+                std::cout << std::left << std::setw(32) << "variant" << std::right << std::setw(12) << "steps"
+                    << std::setw(14) << "steps/s" << "  first divergence\n";
+                for(auto const& run : runs) {
+                    auto const seconds = std::chrono::duration<double>(run.time).count();
+                    std::cout << std::left << std::setw(32) << run.name << std::right << std::setw(12) << run.steps
+                        << std::setw(14) << std::fixed << std::setprecision(0) << (seconds > 0 ? run.steps / seconds : 0.0)
+                        << "  " << (run.divergence.empty() ? "-" : run.divergence) << "\n";
+                }
+                return diverged ? EXIT_FAILURE : EXIT_SUCCESS;
+            }
+            """.trimIndent()
+        writeCode(folder, name + "_differential", sourceExtension, harness)
+
+        val objects = variants.joinToString(" ") { "${name}_${it.name}.o" }
+        val makefile = buildString {
+            appendLine("#differential harness of $name: make -f ${name}_differential.mk && ./${name}_differential TRACE...")
+            appendLine("CXX ?= g++")
+            appendLine("CXXFLAGS ?= -std=c++17 -O2")
+            appendLine()
+            appendLine("${name}_differential: ${name}_differential$sourceExtension $objects")
+            appendLine("\t$(CXX) $(CXXFLAGS) -o $@ $^ -pthread")
+            variants.forEach { v ->
+                appendLine()
+                appendLine("${name}_${v.name}.o: ${name}_variant$sourceExtension $name$sourceExtension $name$headerExtension ${name}_differential$headerExtension")
+                appendLine("\t$(CXX) $(CXXFLAGS) -DMONITOR_VARIANT=${v.name} ${v.defines.joinToString(" ") { "-D$it" }} -c -o $@ $<")
+            }
+        }
+        writeCode(folder, name + "_differential", ".mk", makefile)
+    }
+
     fun writeFuzzyHeader(folder: Path) {
         writeCode(folder, "q_value", headerExtension, qValueCode)
     }
@@ -659,6 +2177,34 @@ object CppGen {
         writeCode(folder, "ring_buffer", headerExtension, ringBufferCode)
     }
 
+    fun writeDbmImpl(folder: Path) {
+        writeCode(folder, "dbm", headerExtension, dbmCode)
+    }
+
+    fun writeTriValueImpl(folder: Path) {
+        writeCode(folder, "tri_value", headerExtension, triValueCode)
+    }
+
+    fun writeSharedTraceImpl(folder: Path) {
+        writeCode(folder, "shared_trace", headerExtension, sharedTraceCode)
+    }
+
+    fun writeWorkStealingImpl(folder: Path) {
+        writeCode(folder, "work_stealing", headerExtension, workStealingCode)
+    }
+
+    fun writeLruCacheImpl(folder: Path) {
+        writeCode(folder, "lru_cache", headerExtension, lruCacheCode)
+    }
+
+    fun writeAdaptiveTokensImpl(folder: Path) {
+        writeCode(folder, "adaptive_tokens", headerExtension, adaptiveTokensCode)
+    }
+
+    fun writeBitSliceImpl(folder: Path) {
+        writeCode(folder, "bit_slice", headerExtension, bitSliceCode)
+    }
+
     fun writeSystemTu(system: System, folder: Path) {
         val signature = system.signature
         val name = system.name
@@ -781,36 +2327,547 @@ object CppGen {
         writeCode(folder, system.name+"Environment", headerExtension, code)
     }
 
-    private fun Iterable<Variable>.declareMembers(nameSuffix : String = "") = joinToString("\n                ") { "${it.type.name} ${it.name+nameSuffix}{};" }
-
-    private fun Iterable<Variable>.readVars(monitorName : String = "monitor", nameSuffix : String = "") = joinToString("\n                        ") { "$monitorName.${it.name+nameSuffix} = std::stoi(kvs[\"${it.name+nameSuffix}\"]);" }
-
-    private fun Iterable<Variable>.printVars(monitorName : String = "monitor", nameSuffix : String = "") = joinToString("\n                ") { "out << \" ${it.name+nameSuffix} = \" << $monitorName.${it.name+nameSuffix} << ',';" }
-
-    private fun Iterable<Variable>.writeVars(nameSuffix : String = "") = joinToString("\n                    ") { "file << \"${it.name+nameSuffix}=\" << state.${it.name+nameSuffix} << ',';" }
-
-}
-private const val ringBufferCode = """
-#include <utility>
-#include <cstddef>
-#include <new>
-#include <initializer_list>
-#include <algorithm>
-
-//STL compatible container
-//only supports the member functions I need.
-template <typename T, std::size_t N>
-class ring_buffer {
-public:
-
-    class iterator {
-    public:
-
-        iterator(ring_buffer* buffer, size_t index, size_t count)
-            : buffer_(buffer), index_(index), remaining_(count) {}
-
-        T& operator*() { return buffer_->data()[index_]; }
-        T* operator->() { return &buffer_->data()[index_]; }
+    //clock locals, clock history and the transitions of a single token `tok`, successors are added by [insert]
+    private fun tokenStep(
+        contract: Contract, modes: Collection<String>, insert: String, skip: Boolean, profile: MonitorProfile?
+    ): String {
+        val modeName = getModeName(contract.name)
+        return """
+                    ${contract.signature.clocks
+                    .filter { !it.name.isSuffixedClock() }
+                    .joinToString("") {"""
+                    auto ${it.name} = tok.clock_traces.${it.name}_trace.back().total(${contract.clockEpoch()});
+                    auto ${it.name}_e = tok.clock_traces.${it.name}_trace.back().env(${contract.clockEpoch()});
+                    auto ${it.name}_s = tok.clock_traces.${it.name}_trace.back().sys(${contract.clockEpoch()});
+                    """}}
+                    #if !defined(RINGBUFFER) && !defined(SHARED_TRACES)
+                    #ifndef UNBOUNDED_TRACE
+                    ${contract.signature.clocks.filter {
+                        x -> !x.name.isSuffixedClock() && contract.history.none { it.first == x.name } 
+                    }.joinToString("") { """
+                    if(tok.clock_traces.${it.name}_trace.size() > 1)tok.clock_traces.${it.name}_trace.pop_front();""" }}
+                    #endif
+                    ${contract.history.filter {
+                        !it.first.isSuffixedClock() && contract.signature.clocks.any { v -> v.name == it.first } 
+                    }.joinToString("") { (name, depth) -> """
+                    #ifndef UNBOUNDED_TRACE
+                    if(tok.clock_traces.${name}_trace.size() > $depth + 1)tok.clock_traces.${name}_trace.pop_front();
+                    #endif""" +
+                    (1..depth).joinToString("") {"""
+                    auto h_${name}_${it} = ClockHistoryEntry<ClockKind::total,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
+                    auto h_${envClockName(name)}_${it} = ClockHistoryEntry<ClockKind::env,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
+                    auto h_${sysClockName(name)}_${it} = ClockHistoryEntry<ClockKind::sys,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);"""
+                    }}}
+                    #else
+                    //ring_buffer and shared_trace automatically drop old values
+                    ${contract.history.filter {
+                        !it.first.isSuffixedClock() && contract.signature.clocks.any { v -> v.name == it.first }
+                    }.joinToString("") { (name, depth) -> 
+                    (1..depth).joinToString("") {"""
+                    auto h_${name}_${it} = ClockHistoryEntry<ClockKind::total,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
+                    auto h_${envClockName(name)}_${it} = ClockHistoryEntry<ClockKind::env,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);
+                    auto h_${sysClockName(name)}_${it} = ClockHistoryEntry<ClockKind::sys,(int)ClockId::$name>(tok.clock_traces.${name}_trace, $it);"""
+                    }}}
+                    #endif
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                    int fired = 0;
+                    bool self_loops = true;
+                    #endif""" else ""}
+                    switch(tok.mode) {
+                        ${contract.transitions.filter { it.from in modes }.groupBy { it.from }.toList().joinToString("""
+                        """) { "case $modeName::${it.first}: {" + """
+                            #if(PROFILE_MONITOR)${it.second.joinToString("") { t -> """
+                            ++profile[${contract.transitionIndex(t)}].visits;""" }}
+                            #endif""" +
+                        modeGuards(contract, profile?.order(contract, it.second) ?: it.second, insert, skip, profile) + """
+                            break;
+                        };
+                        """ }}
+                        default: break;
+                    }
+                    ${if (skip) """#if(SKIP_UNCHANGED_STEPS)
+                    stationary = stationary && fired == 1 && self_loops;
+                    #endif""" else ""}"""
+    }
+
+    //the successor of a single token is kept inline, further successors go to the general engine
+    private val singleInsert = """
+                                    if(successors++ == 0) {
+                                        successor = std::move(new_tok);
+                                    } else {
+                                        next_tokens.insert(next_tokens.end(), std::move(new_tok));
+                                    }"""
+
+    //continue with the inline token once a single token in a deterministic mode remains
+    private val enterSingleToken = """
+                if(tokens.size() == 1 && is_deterministic(tokens.begin()->mode)) {
+                    single_token = *tokens.begin();
+                    tokens.clear();
+                    single = true;
+                }"""
+
+    private val generalInsert = """
+                                    #if(DEDUPLICATE_TOKENS)
+                                    next_tokens.insert(std::move(new_tok));
+                                    #else
+                                    next_tokens.emplace_back(std::move(new_tok));
+                                    #endif"""
+
+    private fun Contract.transitionIndex(transition: CATransition) = transitions.indexOfFirst { it === transition }
+
+    //branch hint from the profiled rate of a condition
+    private fun hinted(condition: String, likely: Boolean?) = when (likely) {
+        true -> "MONITOR_LIKELY($condition)"
+        false -> "MONITOR_UNLIKELY($condition)"
+        null -> condition
+    }
+
+    private fun modeGuards(
+        contract: Contract, transitions: List<CATransition>, insert: String, skip: Boolean, profile: MonitorProfile?
+    ): String {
+        val sequential = transitions.joinToString("") { transitionCode(contract, it, insert, skip, profile) }
+        val tree = contract.guardTreeOf(transitions) ?: return sequential
+        return """
+                            #if(GUARD_TREES)${guardTreeCode(contract, transitions, tree, insert, skip, profile, "                            ")}
+                            #else$sequential
+                            #endif"""
+    }
+
+    //every path evaluates each atom once, the leaf fires the enabled transitions in declaration order
+    private fun guardTreeCode(
+        contract: Contract, transitions: List<CATransition>, tree: GuardTree, insert: String, skip: Boolean,
+        profile: MonitorProfile?, indent: String
+    ): String = when (tree) {
+        is GuardTree.Branch ->
+            "\n${indent}if(${hinted(tree.atom.toCExpr(), profile?.likely(contract, transitions, tree))}) {" +
+                guardTreeCode(contract, transitions, tree.then, insert, skip, profile, "$indent    ") +
+                "\n$indent} else {" +
+                guardTreeCode(contract, transitions, tree.otherwise, insert, skip, profile, "$indent    ") +
+                "\n$indent}"
+
+        is GuardTree.Leaf -> (if (tree.enabled.isEmpty()) "" else "\n${indent}any_pre = true;") +
+            (if (tree.enabled.isEmpty()) "" else "\n$indent#if(PROFILE_MONITOR)" + tree.enabled.joinToString("") {
+                "\n$indent++profile[${contract.transitionIndex(transitions[it])}].enabled;"
+            } + "\n$indent#endif") +
+            tree.fired.joinToString("") { i ->
+                val transition = transitions[i]
+                val fire = fireCode(contract, transition, skip) + """
+                                    auto new_tok = ${getTokenName(contract.name)}{${getModeName(contract.name)}::${transition.to}, std::move(new_clock_traces)};$insert"""
+                "\n$indent{" + fire.replace("\n                                    ", "\n$indent    ") + "\n$indent}"
+            }
+    }
+
+    private fun fireCode(contract: Contract, transition: CATransition, skip: Boolean) = """
+                                    #if(PROFILE_MONITOR)
+                                    ++profile[${contract.transitionIndex(transition)}].fired;
+                                    #endif
+                                    auto new_clock_traces = tok.clock_traces;
+                                    ${contract.signature.clocks
+                                    .filter { !it.name.isSuffixedClock() }
+                                    .joinToString("") {"""
+                                    {
+                                    auto clockvals = &new_clock_traces.${it.name}_trace;
+                                    auto next_clock = clockvals->back();
+                                    clockvals->push_back(std::move(next_clock));
+                                    }
+                                    """}}
+                                    ${transition.clocks.joinToString(""){"""
+                                    new_clock_traces.${it}_trace.back().reset(${contract.clockEpoch()});
+                                    """
+                                    }}${if (skip) """
+                                    #if(SKIP_UNCHANGED_STEPS)
+                                    ++fired;${if (transition.from == transition.to && transition.clocks.isEmpty()) "" else """
+                                    self_loops = false;"""}
+                                    #endif""" else ""}"""
+
+    private fun transitionCode(
+        contract: Contract, transition: CATransition, insert: String, skip: Boolean, profile: MonitorProfile?
+    ): String {
+        val modeName = getModeName(contract.name)
+        val tokName = getTokenName(contract.name)
+        val pre = transition.contract.pre
+        val post = transition.contract.post
+        //only clock history access can throw, guards without it need no exception handling
+        val history = contract.mentionsClockHistory(pre) || contract.mentionsClockHistory(post)
+        val fire = fireCode(contract, transition, skip)
+        val code = """
+                            ${if (history) "try{" else "{"}
+                            Q_Value pre_cond = ${pre.toCExpr()};
+                            #ifdef FUZZY
+                            pre_cond = q_combine(tok.q_assume, pre_cond);
+                            #endif
+                            if(${hinted("pre_cond", profile?.likely(contract, transition))}) {
+                                any_pre = true;
+                                #if(PROFILE_MONITOR)
+                                ++profile[${contract.transitionIndex(transition)}].enabled;
+                                #endif
+                                ${if (history) "try{" else "{"}
+                                Q_Value post_cond = ${post.toCExpr()};
+                                #ifdef FUZZY
+                                post_cond = q_combine(tok.q_guarantee, post_cond);
+                                #endif
+                                if(post_cond) {$fire
+                                    #ifdef FUZZY
+                                    auto new_tok = $tokName{$modeName::${transition.to}, std::move(new_clock_traces), pre_cond, post_cond};
+                                    #else
+                                    auto new_tok = $tokName{$modeName::${transition.to}, std::move(new_clock_traces)};
+                                    #endif
+                                    $insert
+                                }
+                                ${if (history) """} catch(InvalidTimeAccess const& time_err) {
+                                    postcondition_accessed_incorrect_time = true;
+                                }""" else "}"}
+                            }
+                            ${if (history) """} catch(InvalidTimeAccess const& time_err) {
+                                precondition_accessed_incorrect_time = true;
+                            }""" else "}"}"""
+        if (!history) return code
+        return """
+                            #ifdef NOEXCEPT_TRACE_ACCESS
+                            {
+                            Tri<bool> pre_cond = ${pre.toCExpr()};
+                            precondition_accessed_incorrect_time |= !pre_cond.defined;
+                            if(${hinted("pre_cond.holds()", profile?.likely(contract, transition))}) {
+                                any_pre = true;
+                                #if(PROFILE_MONITOR)
+                                ++profile[${contract.transitionIndex(transition)}].enabled;
+                                #endif
+                                Tri<bool> post_cond = ${post.toCExpr()};
+                                postcondition_accessed_incorrect_time |= !post_cond.defined;
+                                if(post_cond.holds()) {$fire
+                                    auto new_tok = $tokName{$modeName::${transition.to}, std::move(new_clock_traces)};$insert
+                                }
+                            }
+                            }
+                            #else$code
+                            #endif"""
+    }
+
+    //the guards of the transitions leaving the mode of `tok` whose clock-free conditions hold, each atom reports when it flips
+    private fun deadlineCases(contract: Contract, bounds: (ClockRef) -> Pair<String, String>): String {
+        val modeName = getModeName(contract.name)
+        return """
+                    switch(tok.mode) {
+                        ${contract.transitions.groupBy { it.from }.toList().joinToString("\n                        ") { (from, transitions) ->
+                            val terms = transitions.flatMap { t ->
+                                val post = contract.guardTerms(t.contract.post)!!
+                                contract.guardTerms(t.contract.pre)!!.flatMap { pre ->
+                                    post.map { GuardTerm(pre.conditions + it.conditions, pre.atoms + it.atoms) }
+                                }
+                            }.filter { it.atoms.isNotEmpty() }.distinct()
+                            "case $modeName::$from:" + terms.joinToString("") { term -> """
+                            if(${term.conditions.joinToString(" && ") { it.toCExpr() }.ifEmpty { "true" }}) {
+                                ${term.atoms.joinToString("\n                                ") { atom ->
+                                    val (low, high) = bounds(atom.ref)
+                                    //x < c and x >= c flip when x reaches c, x <= c and x > c when it reaches c + 1
+                                    val flip = if (atom.op == SBinaryOperator.LESS_EQUAL || atom.op == SBinaryOperator.GREATER_THAN) " + 1" else ""
+                                    "until($low, $high, (${atom.bound.toCExpr()})$flip);"
+                                }}
+                            }""" } + """
+                            break;"""
+                        }}
+                        default: break;
+                    }"""
+    }
+
+    //all tokens in a mode take the same transitions, the guards are evaluated once per marked mode
+    private fun bitsetUpdate(contract: Contract): String {
+        val modeName = getModeName(contract.name)
+        return """
+                std::bitset<mode_count> next_marking;
+                bool any_pre = false;
+                ${contract.transitions.groupBy { it.from }.toList().joinToString("\n                ") { (from, transitions) ->
+                    "if(marking[(std::size_t)$modeName::$from]) {" + transitions.joinToString("") { """
+                    if(${it.contract.pre.toCExpr()}) {
+                        any_pre = true;
+                        if(${it.contract.post.toCExpr()}) next_marking.set((std::size_t)$modeName::${it.to});
+                    }""" } + """
+                }"""
+                }}
+                marking = next_marking;
+                
+                if(!ENVIRONMENT_LOSES && !SYSTEM_LOSES) {
+                    if(!any_pre) {
+                        ENVIRONMENT_LOSES = true;
+                    }else if(marking.none()) {
+                        SYSTEM_LOSES = true;
+                    }
+                }"""
+    }
+
+    //variables and variable history the guards can read
+    private fun memoValuation(contract: Contract) =
+        (contract.signature.inputs + contract.signature.outputs + contract.signature.internals).map { it.name } +
+            contract.history.filter { contract.signature.clocks.none { v -> v.name == it.first } }
+                .flatMap { (name, depth) -> (1..depth).map { "h_${name}_$it" } }
+
+    //variables with history and its depth
+    private fun variableHistory(contract: Contract) = contract.history.mapNotNull { (name, depth) ->
+        contract.signature.get(name)?.takeIf { name !in contract.baseClocks }?.let { it to depth }
+    }
+
+    //smallest unsigned type holding every state of the DFA
+    private fun dfaEntry(dfa: MarkingDfa) = if (dfa.size <= 1 shl 16) "std::uint16_t" else "std::uint32_t"
+
+    private fun batchType(v: Variable) = if (v.type.name == "bool") "std::uint8_t" else v.type.name
+
+    //the batch of a deterministic contract with one token per instance: an update evaluates the guards of every
+    //transition and selects the successor mode and the clock resets of the transition that fired in the mode of the token
+    private fun tokenBatchCode(contract: Contract): String {
+        val monitorName = getMonitorName(contract.name)
+        val modeName = getModeName(contract.name)
+        val variables = contract.signature.inputs + contract.signature.outputs + contract.signature.internals
+        val history = variableHistory(contract)
+        val initialMode = contract.states.single { it[0].isLowerCase() }
+        //the enum declares the modes in this order
+        val ordinal = contract.states.withIndex().associate { (i, mode) -> mode to i }
+        val clocks = contract.baseClocks.flatMap { listOf("clock_${it}_e", "clock_${it}_s") }
+        val histories = history.flatMap { (v, depth) -> (0..depth).map { "h_${v.name}_$it" } }
+        return """
+            
+            #ifndef FUZZY
+            ${monitorName}Batch::${monitorName}Batch(std::size_t instances) :
+                ${variables.joinToString("") { "${it.name}(instances), " }}mode(instances, $modeName::$initialMode),
+                verdicts(instances)${clocks.joinToString("") { ", $it(instances)" }}${histories.joinToString("") { ", $it(instances)" }} {}
+            
+            void ${monitorName}Batch::advance(int t_e, int t_s) {
+                ${contract.baseClocks.joinToString("\n                ") {
+                    "for(auto& e : clock_${it}_e) e += t_e;\n                for(auto& s : clock_${it}_s) s += t_s;"
+                }}
+            }
+            
+            void ${monitorName}Batch::advance(std::size_t instance, int t_e, int t_s) {
+                ${contract.baseClocks.joinToString("\n                ") {
+                    "clock_${it}_e[instance] += t_e;\n                clock_${it}_s[instance] += t_s;"
+                }}
+            }
+            
+            void ${monitorName}Batch::update() {
+                auto const instances = size();
+                //raw pointers, so the byte stores of one vector do not alias the pointers of the others
+                ${(variables.map { it.name } + histories + listOf("mode", "verdicts") + clocks).joinToString("\n                ") {
+                    "auto* const ${it}_of = this->$it.data();"
+                }}
+                MONITOR_IVDEP
+                for(std::size_t i = 0; i < instances; ++i) {${history.joinToString("") { (v, depth) -> (depth downTo 1).joinToString("") { """
+                    h_${v.name}_${it}_of[i] = h_${v.name}_${it - 1}_of[i];""" } + """
+                    h_${v.name}_0_of[i] = ${v.name}_of[i];""" }}
+                    ${variables.joinToString("\n                    ") { "[[maybe_unused]] auto const ${it.name} = ${it.name}_of[i];" }}
+                    ${history.joinToString("\n                    ") { (v, depth) -> (0..depth).joinToString("\n                    ") {
+                        "[[maybe_unused]] auto const h_${v.name}_$it = h_${v.name}_${it}_of[i];"
+                    } }}
+                    ${contract.baseClocks.joinToString("\n                    ") {
+                        "[[maybe_unused]] auto const ${it}_e = clock_${it}_e_of[i];\n                    " +
+                        "[[maybe_unused]] auto const ${it}_s = clock_${it}_s_of[i];\n                    " +
+                        "[[maybe_unused]] auto const $it = ${it}_e + ${it}_s;"
+                    }}
+                    //the guards of every transition are evaluated as masks, the mode of the token selects which count.
+                    //at most one transition leaving a deterministic mode fires
+                    auto const from = static_cast<int>(mode_of[i]);${contract.transitions.withIndex().joinToString("") { (k, t) -> """
+                    int const pre_$k = (from == ${ordinal.getValue(t.from)}) & static_cast<bool>(${t.contract.pre.toCExpr()});
+                    int const fire_$k = pre_$k & static_cast<bool>(${t.contract.post.toCExpr()});""" }}
+                    int const any_pre = ${contract.transitions.indices.joinToString(" | ") { "pre_$it" }.ifEmpty { "0" }};
+                    int const fired = ${contract.transitions.indices.joinToString(" | ") { "fire_$it" }.ifEmpty { "0" }};
+                    int const to = ${contract.transitions.withIndex().joinToString(" + ") { (k, t) -> "fire_$k * ${ordinal.getValue(t.to)}" }.ifEmpty { "0" }};
+                    ${contract.baseClocks.joinToString("\n                    ") { c ->
+                        "int const reset_$c = " + contract.transitions.withIndex().filter { (_, t) -> c in t.clocks }
+                            .joinToString(" | ") { (k, _) -> "fire_$k" }.ifEmpty { "0" } + ";"
+                    }}
+                    //instances with a verdict keep it and their token
+                    int const running = verdicts_of[i] == 0;
+                    mode_of[i] = static_cast<$modeName>(from + (running & fired) * (to - from));${contract.baseClocks.joinToString("") { """
+                    clock_${it}_e_of[i] = ${it}_e * !(running & reset_$it);
+                    clock_${it}_s_of[i] = ${it}_s * !(running & reset_$it);""" }}
+                    verdicts_of[i] += running * (!any_pre + 2 * (any_pre & !fired));
+                }
+            }
+            
+            int ${monitorName}Batch::verdict(std::size_t instance) const {
+                return verdicts[instance];
+            }
+            
+            std::size_t ${monitorName}Batch::stopped() const {
+                return std::count_if(verdicts.begin(), verdicts.end(), [](auto verdict) { return verdict != 0; });
+            }
+            #endif"""
+    }
+
+    private fun dfaTables(dfa: MarkingDfa): String {
+        val entry = dfaEntry(dfa)
+        return """
+            //minimal DFA over the markings, indexed by state and truth vector of the atomic predicates
+            static constexpr $entry dfa_next[${dfa.size}][${1 shl dfa.predicates.size}] = {
+                ${dfa.next.joinToString(",\n                ") { row -> row.joinToString(", ", "{", "}") }}
+            };
+            //0: running, 1: environment loses, 2: system loses
+            static constexpr std::uint8_t dfa_verdict[${dfa.size}] = {${dfa.verdicts.joinToString(", ") { "${it.ordinal}" }}};"""
+    }
+
+    //steps of advance_and_update_n for the DFA state or the marking: once the variable history holds the repeated
+    //valuation, every step maps the state by the same function, so the states become periodic. A period without
+    //verdict is detected when a state repeats and whole periods are skipped, verdicts are sticky
+    private fun periodJump(state: String, states: String, historyDepth: Int) = """
+                for(; steps < n && steps < $historyDepth && !should_stop(); ++steps) {
+                    advance(t_e, t_s);
+                    update();
+                }
+                if(n - steps > $states) {
+                    //step at which every state was first reached
+                    std::unordered_map<decltype($state), std::size_t> reached{{$state, steps}};
+                    while(steps < n && !should_stop()) {
+                        advance(t_e, t_s);
+                        update();
+                        ++steps;
+                        auto const [first, fresh] = reached.emplace($state, steps);
+                        if(!fresh) {
+                            steps = n - (n - steps) % (steps - first->second);
+                            break;
+                        }
+                    }
+                }"""
+
+    //the token loop is replaced by a table lookup, the verdict is read off the entered state
+    private fun dfaUpdate() = """
+                dfa_state = dfa_next[dfa_state][predicate_vector()];
+                
+                if(!ENVIRONMENT_LOSES && !SYSTEM_LOSES) {
+                    ENVIRONMENT_LOSES = dfa_verdict[dfa_state] == 1;
+                    SYSTEM_LOSES = dfa_verdict[dfa_state] == 2;
+                }"""
+
+    //macros of the chosen backend, each only if no conflicting macro is set
+    private fun backendDefines(backend: Backend) = backend.defines.toList().joinToString("") { (macro, value) ->
+        val unset = when (macro) {
+            "ADAPTIVE_TOKENS" -> "!defined(ADAPTIVE_TOKENS) && !defined(DEDUPLICATE_TOKENS) && !(defined(CLOCK_INDEX) && CLOCK_INDEX) && !defined(FUZZY)"
+            "DEDUPLICATE_TOKENS" -> "!defined(DEDUPLICATE_TOKENS) && !(defined(CLOCK_INDEX) && CLOCK_INDEX)"
+            "RINGBUFFER" -> "!defined(RINGBUFFER) && !defined(SHARED_TRACES) && !defined(UNBOUNDED_TRACE)"
+            "SHARED_TRACES" -> "!defined(RINGBUFFER) && !defined(SHARED_TRACES) && !(defined(PARALLEL_TOKENS) && PARALLEL_TOKENS)"
+            else -> "!defined($macro)"
+        }
+        """
+            #if $unset
+            #define ${"$macro $value".trim()}
+            #endif"""
+    }
+
+    //one window per term of a precondition, a term without bounds on the key spans the whole mode
+    private fun indexWindows(contract: Contract, key: ClockRef): String {
+        val modeName = getModeName(contract.name)
+        val whole = "window([](auto) { return true; }, [](auto) { return true; });"
+        fun bounds(atoms: List<ClockAtom>) = atoms.joinToString(" && ") { "clock_value ${it.op.symbol()} (${it.bound.toCExpr()})" }
+            .ifEmpty { "true" }
+        return contract.transitions.groupBy { it.from }.toList().joinToString("\n                        ") { (from, transitions) ->
+            val windows = transitions.flatMap { t ->
+                contract.guardTerms(t.contract.pre)?.map { term ->
+                    val atoms = term.atoms.filter { it.ref == key }
+                    val lower = atoms.filter { it.op == SBinaryOperator.GREATER_THAN || it.op == SBinaryOperator.GREATER_EQUAL }
+                    val upper = atoms.filter { it.op == SBinaryOperator.LESS_THAN || it.op == SBinaryOperator.LESS_EQUAL }
+                    if (atoms.isEmpty()) whole
+                    else "window([&](auto clock_value) { return ${bounds(lower)}; }, [&](auto clock_value) { return ${bounds(upper)}; });"
+                } ?: listOf(whole)
+            }.distinct()
+            "case $modeName::$from:" + windows.joinToString("") { "\n                            $it" } + "\n                            break;"
+        }
+    }
+
+    //a concrete token has a single value for every clock part
+    //argument of the clock accessors, the epoch of the monitor when TIMESTAMP_CLOCKS is available
+    private fun Contract.clockEpoch() = if (hasClockHistory()) "" else "CLOCK_EPOCH"
+
+    private fun tracePartBounds(contract: Contract, ref: ClockRef): Pair<String, String> {
+        val part = when (ref.part) {
+            ClockPart.TOTAL -> "total(${contract.clockEpoch()})"
+            ClockPart.ENV -> "env(${contract.clockEpoch()})"
+            ClockPart.SYS -> "sys(${contract.clockEpoch()})"
+        }
+        val value = "tok.clock_traces.${ref.clock}_trace.back().$part"
+        return value to value
+    }
+
+    //the clock traces of a token after its self-loop without clock resets
+    private fun repeatSelfLoop(contract: Contract) = contract.baseClocks.joinToString("") {"""
+                        #if !defined(RINGBUFFER) && !defined(SHARED_TRACES) && !defined(UNBOUNDED_TRACE)
+                        if(tok.clock_traces.${it}_trace.size() > 1)tok.clock_traces.${it}_trace.pop_front();
+                        #endif
+                        {
+                        auto next_clock = tok.clock_traces.${it}_trace.back();
+                        tok.clock_traces.${it}_trace.push_back(std::move(next_clock));
+                        }"""
+    }
+
+    private fun crossedBoundCases(contract: Contract) = contract.maxConstants().toList()
+        .mapNotNull { (clock, max) -> max?.let { clock to it } }
+        .filter { (_, max) -> max.constants.isNotEmpty() || max.variables.isNotEmpty() }
+        .joinToString("\n                    ") { (clock, max) ->
+            val bounds = max.constants.distinct().map { it.toString() } + max.variables.distinct()
+            "case ClockId::$clock: return ${bounds.joinToString(" || ") { "within($it)" }};"
+        }
+
+    private fun traceBytes(contract: Contract) = contract.baseClocks.joinToString("\n                    ") {
+        "bytes += tok.clock_traces.${it}_trace.size() * sizeof(tok.clock_traces.${it}_trace.back());"
+    }
+
+    private fun truncateTraces(contract: Contract, tok: String) = contract.baseClocks.joinToString("\n                    ") {
+        "while($tok.clock_traces.${it}_trace.size() > clock_trace_capacity(ClockId::$it)) $tok.clock_traces.${it}_trace.pop_front();"
+    }
+
+    private fun printToken(contract: Contract) = """
+                    #ifdef FUZZY
+                    out << "      " << tok.mode << "    ("<<tok.q_assume<<","<<tok.q_guarantee<<")\n";
+                    #else
+                    out << "      " << tok.mode << "\n";
+                    #endif
+                    
+                    ${contract.signature.clocks
+                    .filter { !it.name.isSuffixedClock() }
+                    .joinToString("") {"""
+                    out << "        ${it.name}\n           " << tok.clock_traces.${it.name}_trace << "\n"; 
+                    """
+                    }}"""
+
+    private fun maxConstantCases(contract: Contract) = contract.maxConstants().toList()
+        .mapNotNull { (clock, max) -> max?.let { clock to it } }
+        .joinToString("\n                    ") { (clock, max) ->
+            val bound = "std::max({${(listOf("0") + max.constants.map { it.toString() } + max.variables.distinct().map { "MAX_$it" }).joinToString(", ")}})"
+            if (max.variables.isEmpty()) "case ClockId::$clock: return $bound;"
+            else """case ClockId::$clock:
+                    #if ${max.variables.distinct().joinToString(" && ") { "defined(MAX_$it)" }}
+                        return $bound;
+                    #else
+                        return -1;
+                    #endif"""
+        }
+
+    private fun Iterable<Variable>.declareMembers(nameSuffix : String = "") = joinToString("\n                ") { "${it.type.name} ${it.name+nameSuffix}{};" }
+
+    private fun Iterable<Variable>.readVars(monitorName : String = "monitor", nameSuffix : String = "") = joinToString("\n                        ") { "$monitorName.${it.name+nameSuffix} = std::stoi(kvs[\"${it.name+nameSuffix}\"]);" }
+
+    private fun Iterable<Variable>.printVars(monitorName : String = "monitor", nameSuffix : String = "") = joinToString("\n                ") { "out << \" ${it.name+nameSuffix} = \" << $monitorName.${it.name+nameSuffix} << ',';" }
+
+    private fun Iterable<Variable>.writeVars(nameSuffix : String = "") = joinToString("\n                    ") { "file << \"${it.name+nameSuffix}=\" << state.${it.name+nameSuffix} << ',';" }
+
+}
+private const val ringBufferCode = """
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <initializer_list>
+#include <algorithm>
+
+//STL compatible container
+//only supports the member functions I need.
+template <typename T, std::size_t N>
+class ring_buffer {
+public:
+
+    class iterator {
+    public:
+
+        iterator(ring_buffer* buffer, size_t index, size_t count)
+            : buffer_(buffer), index_(index), remaining_(count) {}
+
+        T& operator*() { return buffer_->data()[index_]; }
+        T* operator->() { return &buffer_->data()[index_]; }
 
         iterator& operator++() {
             index_ = (index_ + 1) % N;
@@ -886,6 +2943,11 @@ public:
             push_back(std::move(v));
         }
     }
+    ring_buffer(const ring_buffer& other) : ring_buffer() {
+        for (const auto& item : other) {
+            push_back(item);
+        }
+    }
     ~ring_buffer() { clear(); }
 
     bool empty() const { return count_ == 0; }
@@ -955,9 +3017,706 @@ private:
     size_t end_;
     size_t count_;
 
-    T* data() { return reinterpret_cast<T*>(buffer_); }
-    const T* data() const { return reinterpret_cast<const T*>(buffer_); }
+    //the elements live in the storage by placement new, launder makes them reachable through its address
+    T* data() { return std::launder(reinterpret_cast<T*>(buffer_)); }
+    const T* data() const { return std::launder(reinterpret_cast<const T*>(buffer_)); }
+};
+
+"""
+private const val workStealingCode = """
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//fixed set of worker threads running indexed tasks
+//every worker starts with a contiguous range of the tasks and steals from the other ends when it runs out,
+//the calling thread takes part as worker 0.
+class work_stealing_pool {
+    struct queue {
+        std::mutex lock;
+        std::deque<std::size_t> tasks;
+    };
+
+    std::vector<queue> queues_;
+    std::vector<std::thread> threads_;
+    std::function<void(std::size_t)> job_;
+    std::mutex lock_;
+    std::mutex run_lock_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    std::size_t generation_ = 0;
+    std::size_t active_ = 0;
+    bool stop_ = false;
+
+    bool pop(std::size_t worker, std::size_t& task) {
+        {
+            std::lock_guard<std::mutex> guard{queues_[worker].lock};
+            auto& own = queues_[worker].tasks;
+            if(!own.empty()) {
+                task = own.back();
+                own.pop_back();
+                return true;
+            }
+        }
+        for(std::size_t i = 1; i < queues_.size(); ++i) {
+            auto& victim = queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> guard{victim.lock};
+            if(!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(std::size_t worker) {
+        std::size_t task;
+        while(pop(worker, task)) job_(task);
+    }
+
+    void loop(std::size_t worker) {
+        std::size_t seen = 0;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> guard{lock_};
+                start_.wait(guard, [&] { return stop_ || generation_ != seen; });
+                if(stop_) return;
+                seen = generation_;
+            }
+            work(worker);
+            std::lock_guard<std::mutex> guard{lock_};
+            if(--active_ == 0) done_.notify_all();
+        }
+    }
+
+public:
+    explicit work_stealing_pool(std::size_t workers) : queues_(workers == 0 ? 1 : workers) {
+        for(std::size_t i = 1; i < queues_.size(); ++i) {
+            threads_.emplace_back([this, i] { loop(i); });
+        }
+    }
+    work_stealing_pool(work_stealing_pool const&) = delete;
+    work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+    ~work_stealing_pool() {
+        {
+            std::lock_guard<std::mutex> guard{lock_};
+            stop_ = true;
+        }
+        start_.notify_all();
+        for(auto& thread : threads_) thread.join();
+    }
+
+    [[nodiscard]] std::size_t size() const { return queues_.size(); }
+
+    //calls task(i) for every i < count and returns once all calls are done
+    void run(std::size_t count, std::function<void(std::size_t)> task) {
+        std::lock_guard<std::mutex> running{run_lock_};
+        auto const workers = queues_.size();
+        for(std::size_t w = 0; w < workers; ++w) {
+            std::lock_guard<std::mutex> guard{queues_[w].lock};
+            for(std::size_t i = w * count / workers; i < (w + 1) * count / workers; ++i) {
+                queues_[w].tasks.push_back(i);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard{lock_};
+            job_ = std::move(task);
+            active_ = workers - 1;
+            ++generation_;
+        }
+        start_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> guard{lock_};
+        done_.wait(guard, [this] { return active_ == 0; });
+        job_ = nullptr;
+    }
 };
+"""
+private const val bitSliceCode = """
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+//one bit per lane in N 64-bit words, the operators work lane-wise
+//loops over a fixed number of words are unrolled and vectorised, so N = 4 fills a 256-bit register
+template<std::size_t N>
+struct bit_slice {
+    static constexpr std::size_t lanes = 64 * N;
+    std::array<std::uint64_t, N> words{};
+
+    static bit_slice all() {
+        bit_slice s;
+        s.words.fill(~std::uint64_t{0});
+        return s;
+    }
+
+    [[nodiscard]] bool test(std::size_t lane) const { return words[lane / 64] >> (lane % 64) & 1; }
+
+    void set(std::size_t lane, bool value) {
+        auto const bit = std::uint64_t{1} << (lane % 64);
+        words[lane / 64] = value ? words[lane / 64] | bit : words[lane / 64] & ~bit;
+    }
+
+    [[nodiscard]] bool any() const {
+        std::uint64_t any = 0;
+        for(auto w : words) any |= w;
+        return any != 0;
+    }
+
+    [[nodiscard]] std::size_t count() const {
+        std::size_t count = 0;
+        for(auto w : words) count += std::bitset<64>(w).count();
+        return count;
+    }
+
+    friend bit_slice operator~(bit_slice a) {
+        for(auto& w : a.words) w = ~w;
+        return a;
+    }
+    bit_slice& operator&=(bit_slice const& b) {
+        for(std::size_t i = 0; i < N; ++i) words[i] &= b.words[i];
+        return *this;
+    }
+    bit_slice& operator|=(bit_slice const& b) {
+        for(std::size_t i = 0; i < N; ++i) words[i] |= b.words[i];
+        return *this;
+    }
+    bit_slice& operator^=(bit_slice const& b) {
+        for(std::size_t i = 0; i < N; ++i) words[i] ^= b.words[i];
+        return *this;
+    }
+    friend bit_slice operator&(bit_slice a, bit_slice const& b) { return a &= b; }
+    friend bit_slice operator|(bit_slice a, bit_slice const& b) { return a |= b; }
+    friend bit_slice operator^(bit_slice a, bit_slice const& b) { return a ^= b; }
+};
+"""
+
+private const val lruCacheCode = """
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//hash map of bounded size evicting the least recently used entry
+template<typename K, typename V, typename Hash = std::hash<K>>
+class lru_cache {
+    struct slot {
+        V value;
+        typename std::list<K const*>::iterator use;
+    };
+
+    std::size_t capacity_;
+    std::unordered_map<K, slot, Hash> entries_;
+    //keys of entries_, most recently used first
+    std::list<K const*> uses_;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+
+public:
+    explicit lru_cache(std::size_t capacity) : capacity_(capacity) {}
+
+    //the cached value or nullptr, a hit makes the entry the most recently used one
+    V const* find(K const& key) {
+        auto it = entries_.find(key);
+        if(it == entries_.end()) {
+            ++misses_;
+            return nullptr;
+        }
+        ++hits_;
+        uses_.splice(uses_.begin(), uses_, it->second.use);
+        return &it->second.value;
+    }
+
+    //the entry that was replaced or evicted to make room, if any
+    std::optional<std::pair<K, V>> insert(K key, V value) {
+        if(capacity_ == 0) return std::pair<K, V>{std::move(key), std::move(value)};
+        auto it = entries_.find(key);
+        if(it != entries_.end()) {
+            std::swap(it->second.value, value);
+            uses_.splice(uses_.begin(), uses_, it->second.use);
+            return std::pair<K, V>{std::move(key), std::move(value)};
+        }
+        std::optional<std::pair<K, V>> evicted;
+        if(entries_.size() == capacity_) {
+            auto victim = entries_.find(*uses_.back());
+            uses_.pop_back();
+            evicted.emplace(victim->first, std::move(victim->second.value));
+            entries_.erase(victim);
+        }
+        it = entries_.emplace(std::move(key), slot{std::move(value), {}}).first;
+        uses_.push_front(&it->first);
+        it->second.use = uses_.begin();
+        return evicted;
+    }
+
+    [[nodiscard]] std::size_t size() const { return entries_.size(); }
+    [[nodiscard]] std::size_t hits() const { return hits_; }
+    [[nodiscard]] std::size_t misses() const { return misses_; }
+};
+
+//markings numbered by interning, M is a container of tokens with operator< and a hash() of its tokens.
+//a marking is kept while it is acquired, the ids of released markings are reused
+template<typename M>
+class marking_table {
+    struct marking_hash {
+        std::size_t operator()(M const& marking) const {
+            //a sum does not depend on the order of the tokens
+            std::size_t h = marking.size();
+            for(auto const& tok : marking) h += tok.hash();
+            return h;
+        }
+    };
+    struct marking_equal {
+        bool operator()(M const& lhs, M const& rhs) const { return !(lhs < rhs) && !(rhs < lhs); }
+    };
+
+    std::unordered_map<M, std::size_t, marking_hash, marking_equal> ids_;
+    //interned marking and its number of acquisitions by id, nullptr for a free id
+    std::vector<M const*> markings_;
+    std::vector<std::size_t> references_;
+    std::vector<std::size_t> free_;
+
+public:
+    //the id of marking, a new marking is copied into the table
+    std::size_t intern(M const& marking) {
+        auto found = ids_.find(marking);
+        if(found != ids_.end()) return found->second;
+        std::size_t id = markings_.size();
+        if(free_.empty()) {
+            markings_.push_back(nullptr);
+            references_.push_back(0);
+        } else {
+            id = free_.back();
+            free_.pop_back();
+        }
+        auto const it = ids_.emplace(marking, id).first;
+        markings_[id] = &it->first;
+        return id;
+    }
+
+    [[nodiscard]] M const& operator[](std::size_t id) const { return *markings_[id]; }
+
+    void acquire(std::size_t id) { ++references_[id]; }
+    void release(std::size_t id) {
+        if(--references_[id] > 0) return;
+        ids_.erase(*markings_[id]);
+        markings_[id] = nullptr;
+        free_.push_back(id);
+    }
+
+    [[nodiscard]] std::size_t size() const { return ids_.size(); }
+};
+
+//hash of a key of the memo cache: the id of a marking and the values of the variables
+struct memo_key_hash {
+    template<typename... Ts>
+    std::size_t operator()(std::pair<std::size_t, std::tuple<Ts...>> const& key) const {
+        std::size_t h = key.first;
+        std::apply([&h](auto const&... values) {
+            ((h = (h ^ std::hash<std::decay_t<decltype(values)>>{}(values)) * 1099511628211u), ...);
+        }, key.second);
+        return h;
+    }
+};
+"""
+
+private const val adaptiveTokensCode = """
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+//set of tokens for markings of very different sizes, T needs operator< and a hash() consistent with it.
+//the tokens are stored in insertion order in one vector next to their hashes. up to Threshold tokens a duplicate
+//is found by a linear scan of the hashes, above that through an open-addressing hash index over the vector.
+//a marking that follows an indexed one keeps the index until it shrinks to Threshold / 4 tokens, so a marking
+//around the threshold does not switch back and forth in every step.
+template<typename T, std::size_t Threshold>
+class adaptive_tokens {
+    std::vector<T> items_;
+    std::vector<std::size_t> hashes_;
+    //positions in items_ + 1, 0 is a free slot. power of two sized, at most half full, empty while the marking is small
+    std::vector<std::size_t> index_;
+    //sum of hashes_, the same for every insertion order
+    std::size_t digest_ = 0;
+
+    [[nodiscard]] bool holds(std::size_t item, T const& tok, std::size_t hash) const {
+        return hashes_[item] == hash && !(items_[item] < tok) && !(tok < items_[item]);
+    }
+
+    //the slot holding a token equal to tok or the free slot it belongs into
+    [[nodiscard]] std::size_t& probe(T const& tok, std::size_t hash) {
+        auto const mask = index_.size() - 1;
+        for(auto i = hash & mask;; i = (i + 1) & mask) {
+            auto& slot = index_[i];
+            if(slot == 0 || holds(slot - 1, tok, hash)) return slot;
+        }
+    }
+
+    void rehash(std::size_t slots) {
+        index_.assign(slots, 0);
+        auto const mask = slots - 1;
+        for(std::size_t item = 0; item < items_.size(); ++item) {
+            auto i = hashes_[item] & mask;
+            while(index_[i] != 0) i = (i + 1) & mask;
+            index_[i] = item + 1;
+        }
+    }
+
+    [[nodiscard]] static std::size_t slots_for(std::size_t tokens) {
+        std::size_t slots = 16;
+        while(slots < 2 * tokens) slots *= 2;
+        return slots;
+    }
+
+public:
+    using value_type = T;
+    using const_iterator = typename std::vector<T>::const_iterator;
+    using iterator = const_iterator;
+
+    adaptive_tokens() = default;
+    adaptive_tokens(std::initializer_list<T> tokens) {
+        for(auto const& tok : tokens) insert(tok);
+    }
+
+    //takes over the representation of the marking of the previous step, see above
+    void follow(adaptive_tokens const& previous) {
+        items_.reserve(previous.size());
+        hashes_.reserve(previous.size());
+        if(!previous.index_.empty() && previous.size() > Threshold / 4) {
+            rehash(slots_for(previous.size() > Threshold ? previous.size() : Threshold));
+        }
+    }
+
+    std::pair<const_iterator, bool> insert(T tok) {
+        auto const hash = tok.hash();
+        if(index_.empty()) {
+            for(std::size_t item = 0; item < items_.size(); ++item) {
+                if(holds(item, tok, hash)) return {items_.cbegin() + item, false};
+            }
+            items_.push_back(std::move(tok));
+            hashes_.push_back(hash);
+            digest_ += hash;
+            if(items_.size() > Threshold) rehash(slots_for(items_.size()));
+            return {std::prev(items_.cend()), true};
+        }
+        auto& slot = probe(tok, hash);
+        if(slot != 0) return {items_.cbegin() + (slot - 1), false};
+        items_.push_back(std::move(tok));
+        hashes_.push_back(hash);
+        digest_ += hash;
+        slot = items_.size();
+        if(2 * items_.size() > index_.size()) rehash(2 * index_.size());
+        return {std::prev(items_.cend()), true};
+    }
+    const_iterator insert(const_iterator, T tok) { return insert(std::move(tok)).first; }
+
+    //moves the tokens of other into this, other is empty afterwards
+    void merge(adaptive_tokens& other) {
+        for(auto& tok : other.items_) insert(std::move(tok));
+        other.clear();
+    }
+
+    void clear() {
+        items_.clear();
+        hashes_.clear();
+        index_.clear();
+        digest_ = 0;
+    }
+
+    [[nodiscard]] std::size_t size() const { return items_.size(); }
+    [[nodiscard]] bool empty() const { return items_.empty(); }
+    [[nodiscard]] bool indexed() const { return !index_.empty(); }
+    [[nodiscard]] const_iterator begin() const { return items_.cbegin(); }
+    [[nodiscard]] const_iterator end() const { return items_.cend(); }
+
+    [[nodiscard]] std::size_t hash() const { return digest_; }
+
+    //independent of insertion order, so the same marking reached in different order is one key of MEMO_CACHE.
+    //orders by size and digest first and only sorts copies of the tokens when both agree
+    [[nodiscard]] bool operator<(adaptive_tokens const& rhs) const {
+        if(size() != rhs.size()) return size() < rhs.size();
+        if(digest_ != rhs.digest_) return digest_ < rhs.digest_;
+        auto lhs_items = items_;
+        auto rhs_items = rhs.items_;
+        std::sort(lhs_items.begin(), lhs_items.end());
+        std::sort(rhs_items.begin(), rhs_items.end());
+        return lhs_items < rhs_items;
+    }
+};
+"""
+
+private const val sharedTraceCode = """
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//STL like trace of at most N values, N = 0 is unbounded, T needs operator<, operator== and hash()
+//the last value is stored inline, older values are immutable hash-consed nodes shared between all traces.
+//an unbounded trace keeps them as a chain, so copying a trace copies a pointer and equal histories are the same node.
+//a bounded trace keeps its N - 1 older values in a ring of nodes with an offset, so a push interns one value
+//instead of the whole history.
+//the node table is global and not thread safe.
+template <typename T, std::size_t N>
+class shared_trace {
+    struct node {
+        T value;
+        //older values of an unbounded trace, moved out when the node is released
+        mutable std::shared_ptr<node const> prev;
+        std::size_t size;
+        //creation order, unique for every node
+        std::size_t serial;
+    };
+    using node_ptr = std::shared_ptr<node const>;
+    using key = std::pair<T, std::size_t>;
+    struct key_hash {
+        std::size_t operator()(key const& k) const { return k.first.hash() * 1099511628211u ^ k.second; }
+    };
+    static constexpr std::size_t ring_size = N > 1 ? N - 1 : 1;
+
+    static std::unordered_map<key, std::weak_ptr<node const>, key_hash>& table() {
+        static std::unordered_map<key, std::weak_ptr<node const>, key_hash> nodes;
+        return nodes;
+    }
+
+    static std::size_t serial(node_ptr const& n) { return n ? n->serial : 0; }
+    static std::size_t chain_size(node_ptr const& n) { return n ? n->size : 0; }
+
+    static node_ptr intern(T const& value, node_ptr prev) {
+        static std::size_t next_serial = 0;
+        key k{value, serial(prev)};
+        auto& entry = table()[k];
+        if(auto existing = entry.lock()) return existing;
+        auto size = 1 + chain_size(prev);
+        auto n = node_ptr(new node{value, std::move(prev), size, ++next_serial}, [k](node const* n) {
+            table().erase(k);
+            auto older = std::move(n->prev);
+            delete n;
+            //a chain is released node by node instead of one nested deleter per node
+            while(older && older.use_count() == 1) {
+                auto next = std::move(older->prev);
+                older.reset();
+                older = std::move(next);
+            }
+        });
+        entry = n;
+        return n;
+    }
+
+    //the newest max_size values of the chain
+    static node_ptr truncate(node_ptr const& n, std::size_t max_size) {
+        if(chain_size(n) <= max_size) return n;
+        std::vector<node const*> kept;
+        for(auto i = n.get(); kept.size() < max_size; i = i->prev.get()) kept.push_back(i);
+        node_ptr chain;
+        for(auto it = kept.rbegin(); it != kept.rend(); ++it) chain = intern((*it)->value, std::move(chain));
+        return chain;
+    }
+
+    //older value i of a bounded trace, 0 is the oldest
+    [[nodiscard]] node_ptr const& ring_at(std::size_t i) const { return ring_[(offset_ + i) % ring_size]; }
+
+public:
+    shared_trace() = default;
+    shared_trace(std::initializer_list<T> values) {
+        for(auto const& v : values) push_back(v);
+    }
+
+    [[nodiscard]] bool empty() const { return !has_back_; }
+    [[nodiscard]] std::size_t size() const { return has_back_ + (N == 0 ? chain_size(history_) : count_); }
+
+    void push_back(T value) {
+        if(has_back_) {
+            if constexpr(N == 0) {
+                history_ = intern(back_, std::move(history_));
+            } else if constexpr(N > 1) {
+                //a full ring overwrites its oldest value
+                ring_[(offset_ + count_) % ring_size] = intern(back_, nullptr);
+                if(count_ < ring_size) ++count_;
+                else offset_ = (offset_ + 1) % ring_size;
+            }
+        }
+        back_ = std::move(value);
+        has_back_ = true;
+    }
+    void pop_front() {
+        if constexpr(N == 0) {
+            if(history_) history_ = truncate(history_, history_->size - 1);
+            else has_back_ = false;
+        } else {
+            if(count_ > 0) {
+                ring_[offset_].reset();
+                offset_ = (offset_ + 1) % ring_size;
+                --count_;
+            } else {
+                has_back_ = false;
+            }
+        }
+    }
+
+    T& back() { return back_; }
+    T const& back() const { return back_; }
+
+    //the oldest value has index 0, access to an unbounded trace walks the history from the back
+    T const& operator[](std::size_t idx) const {
+        auto depth = size() - idx - 1;
+        if(depth == 0) return back_;
+        if constexpr(N == 0) {
+            auto n = history_.get();
+            while(--depth > 0) n = n->prev.get();
+            return n->value;
+        } else {
+            return ring_at(idx)->value;
+        }
+    }
+
+    [[nodiscard]] bool operator==(shared_trace const& rhs) const {
+        if(has_back_ != rhs.has_back_ || !(back_ == rhs.back_)) return false;
+        if constexpr(N == 0) {
+            return history_ == rhs.history_;
+        } else {
+            if(count_ != rhs.count_) return false;
+            for(std::size_t i = 0; i < count_; ++i) {
+                if(ring_at(i) != rhs.ring_at(i)) return false;
+            }
+            return true;
+        }
+    }
+    [[nodiscard]] bool operator<(shared_trace const& rhs) const {
+        if(has_back_ != rhs.has_back_) return has_back_ < rhs.has_back_;
+        if(back_ < rhs.back_) return true;
+        if(rhs.back_ < back_) return false;
+        if constexpr(N == 0) {
+            return serial(history_) < serial(rhs.history_);
+        } else {
+            if(count_ != rhs.count_) return count_ < rhs.count_;
+            for(std::size_t i = 0; i < count_; ++i) {
+                auto const lhs_serial = serial(ring_at(i));
+                auto const rhs_serial = serial(rhs.ring_at(i));
+                if(lhs_serial != rhs_serial) return lhs_serial < rhs_serial;
+            }
+            return false;
+        }
+    }
+
+private:
+    T back_{};
+    bool has_back_ = false;
+    //older values of an unbounded trace
+    node_ptr history_;
+    //older values of a bounded trace, count_ of them starting at offset_
+    std::array<node_ptr, ring_size> ring_{};
+    std::size_t offset_ = 0;
+    std::size_t count_ = 0;
+};
+
+"""
+private const val triValueCode = """
+#include <type_traits>
+
+struct TriBase {};
+
+//value of a guard that may access clock history before it exists
+//an undefined operand makes the result undefined exactly when evaluating it in C++ order would have thrown
+template<typename T>
+struct Tri : TriBase {
+    T value{};
+    bool defined = true;
+
+    constexpr Tri() noexcept = default;
+    constexpr Tri(T value) noexcept : value{value} {}
+    constexpr Tri(T value, bool defined) noexcept : value{value}, defined{defined} {}
+
+    [[nodiscard]] constexpr bool holds() const { return defined && bool(value); }
+};
+
+template<typename T>
+constexpr bool is_tri_v = std::is_base_of_v<TriBase, T>;
+
+template<typename T>
+constexpr auto tri_value(T const& v) {
+    if constexpr(is_tri_v<T>) return v.value;
+    else return v;
+}
+template<typename T>
+constexpr bool tri_defined(T const& v) {
+    if constexpr(is_tri_v<T>) return v.defined;
+    else return true;
+}
+
+template<typename L, typename R>
+using enable_tri_t = std::enable_if_t<is_tri_v<L> || is_tri_v<R>>;
+
+#define TRI_BINARY_OPERATOR(op) \
+template<typename L, typename R, typename = enable_tri_t<L, R>> \
+constexpr auto operator op(L const& l, R const& r) { \
+    using V = decltype(tri_value(l) op tri_value(r)); \
+    return Tri<V>{tri_value(l) op tri_value(r), tri_defined(l) && tri_defined(r)}; \
+}
+TRI_BINARY_OPERATOR(+)
+TRI_BINARY_OPERATOR(-)
+TRI_BINARY_OPERATOR(*)
+TRI_BINARY_OPERATOR(^)
+TRI_BINARY_OPERATOR(<<)
+TRI_BINARY_OPERATOR(>>)
+TRI_BINARY_OPERATOR(<)
+TRI_BINARY_OPERATOR(<=)
+TRI_BINARY_OPERATOR(>)
+TRI_BINARY_OPERATOR(>=)
+TRI_BINARY_OPERATOR(==)
+TRI_BINARY_OPERATOR(!=)
+#undef TRI_BINARY_OPERATOR
+
+//an undefined divisor must not be evaluated
+#define TRI_DIVISION_OPERATOR(op) \
+template<typename L, typename R, typename = enable_tri_t<L, R>> \
+constexpr auto operator op(L const& l, R const& r) { \
+    using V = decltype(tri_value(l) op tri_value(r)); \
+    return Tri<V>{tri_defined(r) ? tri_value(l) op tri_value(r) : V{}, tri_defined(l) && tri_defined(r)}; \
+}
+TRI_DIVISION_OPERATOR(/)
+TRI_DIVISION_OPERATOR(%)
+#undef TRI_DIVISION_OPERATOR
+
+//the right operand only matters if C++ would evaluate it
+template<typename L, typename R, typename = enable_tri_t<L, R>>
+constexpr Tri<bool> operator&&(L const& l, R const& r) {
+    bool lv = tri_value(l), rv = tri_value(r);
+    return {lv && rv, tri_defined(l) && (!lv || tri_defined(r))};
+}
+template<typename L, typename R, typename = enable_tri_t<L, R>>
+constexpr Tri<bool> operator||(L const& l, R const& r) {
+    bool lv = tri_value(l), rv = tri_value(r);
+    return {lv || rv, tri_defined(l) && (lv || tri_defined(r))};
+}
+
+template<typename T, typename = std::enable_if_t<is_tri_v<T>>>
+constexpr Tri<bool> operator!(T const& v) {
+    return {!tri_value(v), tri_defined(v)};
+}
+template<typename T, typename = std::enable_if_t<is_tri_v<T>>>
+constexpr auto operator-(T const& v) {
+    return Tri<decltype(-tri_value(v))>{-tri_value(v), tri_defined(v)};
+}
 
 """
 private const val fuzzyImplCode = """
@@ -985,7 +3744,7 @@ auto lt_substitution(T1 v1, T2 v2) {
 	//default to non-fuzzy behaviour
 	return Q_Value(v1 < v2);
 }
-constexpr Q_Value q_combine(Q_Value const& lhs, Q_Value const& rhs) {
+inline Q_Value q_combine(Q_Value const& lhs, Q_Value const& rhs) {
     //default to t-norm
     return t_norm(lhs, rhs);
 }
@@ -1315,4 +4074,5 @@ fun String.isSuffixedClock():Boolean = this.endsWith(envClockNameSuffix) || this
 fun getMonitorName(rcaName : String) = rcaName + "Monitor"
 fun getModeName(rcaName : String) = rcaName + "Mode"
 fun getTokenName(rcaName : String) = rcaName + "Tok"
-fun getClockValuationTraceName(rcaName : String) = rcaName + "ClockValTrace"
\ No newline at end of file
+fun getClockValuationTraceName(rcaName : String) = rcaName + "ClockValTrace"
+fun getZoneTokenName(rcaName : String) = rcaName + "ZoneTok"
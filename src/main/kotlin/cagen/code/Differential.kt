@@ -0,0 +1,71 @@
+package cagen.code
+
+/**
+ * Engine configuration of a monitor in the differential harness: the namespace the monitor is compiled into, the
+ * macros it is compiled with and the variant it is compared with after every step, `null` for a reference that the
+ * others are compared with.
+ */
+data class EngineVariant(val name: String, val defines: List<String>, val reference: String? = REFERENCE)
+
+private const val REFERENCE = "variant_reference"
+
+/**
+ * Macros of the reference monitor: no backend chosen by the analysis and none of the optimisations that are on by
+ * default, so tokens are kept one by one in a vector with `std::deque` traces.
+ */
+private val REFERENCE_DEFINES = listOf(
+    "MANUAL_BACKEND", "DISPLAY_TRACES=0", "MODE_DFA=0", "MODE_BITSET=0", "SINGLE_TOKEN=0",
+    "SKIP_UNCHANGED_STEPS=0", "GUARD_TREES=0"
+)
+
+/**
+ * Engine variants the differential harness replays traces through in lockstep, the reference first. Every variant
+ * but the `generated` ones enables one engine on top of the reference: deduplication with every trace storage, FUZZY,
+ * each engine that is on by default and the engines this contract supports. ERROR_TRACE_ACCESS changes the verdict
+ * of out of bounds clock history, so the trace access modes with it are compared with `error_trace_access` instead.
+ * `generated` is the monitor as `cagen rca` configures it, `generated_tokens` the same without MODE_DFA so its modes
+ * are compared as well. A pruned monitor refuses to compile with FUZZY and has no such variant.
+ */
+fun MonitorPlan.engineVariants(): List<EngineVariant> {
+    //the defines of a variant replace those of the reference for the same macro
+    fun variant(name: String, vararg defines: String, reference: String? = REFERENCE) = EngineVariant(
+        "variant_$name",
+        REFERENCE_DEFINES.filter { r -> defines.none { it.substringBefore('=') == r.substringBefore('=') } } + defines,
+        reference
+    )
+    val history = contract.hasClockHistory()
+    val noexcept = history && contract.clockHistoryOnlyInOperators()
+    return listOfNotNull(
+        variant("reference", reference = null),
+        variant("dedup", "DEDUPLICATE_TOKENS=1"),
+        variant("dedup_exact_clocks", "DEDUPLICATE_TOKENS=1", "EXTRAPOLATE_CLOCKS=0"),
+        variant("ringbuffer", "RINGBUFFER"),
+        variant("ringbuffer_dedup", "RINGBUFFER", "DEDUPLICATE_TOKENS=1"),
+        variant("unbounded_trace", "UNBOUNDED_TRACE"),
+        variant("unbounded_trace_dedup", "UNBOUNDED_TRACE", "DEDUPLICATE_TOKENS=1"),
+        variant("shared_traces", "SHARED_TRACES", "DEDUPLICATE_TOKENS=1"),
+        variant("adaptive_tokens", "ADAPTIVE_TOKENS=4"),
+        variant("extrapolate_clocks", "EXTRAPOLATE_CLOCKS=1"),
+        if (options.pruned) null else variant("fuzzy", "FUZZY"),
+        variant("memo_cache", "MEMO_CACHE=64"),
+        variant("parallel_tokens", "PARALLEL_TOKENS=2", "PARALLEL_THRESHOLD=2"),
+        if (contract.hasGuardTrees()) variant("guard_trees", "GUARD_TREES=1") else null,
+        if (deterministicModes.isNotEmpty()) variant("single_token", "SINGLE_TOKEN=1") else null,
+        if (contract.skippableSteps()) variant("skip_unchanged_steps", "SKIP_UNCHANGED_STEPS=1") else null,
+        if (contract.isClockless()) variant("mode_bitset", "MODE_BITSET=1") else null,
+        dfa?.let { variant("mode_dfa", "MODE_DFA=1") },
+        contract.indexKey()?.let { variant("clock_index", "CLOCK_INDEX=1") },
+        if (history) null else variant("timestamp_clocks", "TIMESTAMP_CLOCKS=1"),
+        if (ZoneGen.isSupported(contract)) variant("zones", "ZONES") else null,
+        if (noexcept) variant("noexcept_trace_access", "NOEXCEPT_TRACE_ACCESS") else null,
+        if (history) variant("error_trace_access", "ERROR_TRACE_ACCESS", reference = null) else null,
+        if (noexcept) {
+            variant(
+                "error_noexcept_trace_access", "ERROR_TRACE_ACCESS", "NOEXCEPT_TRACE_ACCESS",
+                reference = "variant_error_trace_access"
+            )
+        } else null,
+        dfa?.let { EngineVariant("variant_generated_tokens", listOf("DISPLAY_TRACES=0", "MODE_DFA=0")) },
+        EngineVariant("variant_generated", listOf("DISPLAY_TRACES=0")),
+    )
+}
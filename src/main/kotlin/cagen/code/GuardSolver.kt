@@ -0,0 +1,152 @@
+package cagen.code
+
+import cagen.Contract
+import cagen.code.CCodeUtilsSimplified.toCExpr
+import cagen.expr.*
+import cagen.expr.SBinaryOperator.*
+
+/**
+ * Literal of a guard in disjunctive normal form: either a difference constraint `x - y <= c` over signed integer
+ * variables, where `null` stands for zero, or an opaque condition identified by its C expression.
+ */
+private sealed class Literal {
+    data class Difference(val x: String?, val y: String?, val c: Long) : Literal()
+    data class Opaque(val expr: String, val positive: Boolean) : Literal()
+}
+
+private val SIGNED_INTEGER_TYPES = setOf("int", "int8", "int16", "int32", "int64", "short", "long")
+
+/**
+ * Linear expression `sum(coefficients[v] * v) + constant`.
+ */
+private data class Linear(val coefficients: Map<String, Long>, val constant: Long) {
+    operator fun plus(o: Linear) = Linear(
+        (coefficients.keys + o.coefficients.keys).associateWith {
+            (coefficients[it] ?: 0) + (o.coefficients[it] ?: 0)
+        }.filterValues { it != 0L },
+        constant + o.constant
+    )
+
+    operator fun unaryMinus() = Linear(coefficients.mapValues { -it.value }, -constant)
+}
+
+private fun Contract.isSignedInteger(name: String): Boolean {
+    if (clockOf(name) != null) return true
+    val variable = signature.get(name)
+        ?: history.firstNotNullOfOrNull { (n, depth) ->
+            signature.get(n)?.takeIf { (1..depth).any { name == "h_${n}_$it" } }
+        }
+    return variable?.type?.name in SIGNED_INTEGER_TYPES
+}
+
+private fun Contract.linear(expr: SMVExpr): Linear? = when (expr) {
+    is SVariable -> if (isSignedInteger(expr.name)) Linear(mapOf(expr.name to 1L), 0) else null
+    is SIntegerLiteral -> expr.value.toLong().let { Linear(mapOf(), it) }
+    is SWordLiteral -> expr.value.toLong().let { Linear(mapOf(), it) }
+    is SUnaryExpression -> if (expr.operator == SUnaryOperator.MINUS) linear(expr.expr)?.let { -it } else null
+    is SBinaryExpression -> when (expr.operator) {
+        PLUS -> linear(expr.left)?.let { l -> linear(expr.right)?.let { l + it } }
+        MINUS -> linear(expr.left)?.let { l -> linear(expr.right)?.let { l + -it } }
+        else -> null
+    }
+
+    else -> null
+}
+
+/**
+ * `left op right` as difference constraints, `null` if it is not of the form `x - y op c`.
+ */
+private fun Contract.differences(left: SMVExpr, op: SBinaryOperator, right: SMVExpr): List<List<Literal>>? {
+    val diff = linear(left)?.let { l -> linear(right)?.let { l + -it } } ?: return null
+    val pos = diff.coefficients.filterValues { it == 1L }.keys
+    val neg = diff.coefficients.filterValues { it == -1L }.keys
+    if (pos.size > 1 || neg.size > 1 || pos.size + neg.size != diff.coefficients.size) return null
+    val x = pos.firstOrNull()
+    val y = neg.firstOrNull()
+    val c = diff.constant
+    //x - y + c op 0
+    val le = Literal.Difference(x, y, -c)
+    val lt = Literal.Difference(x, y, -c - 1)
+    val ge = Literal.Difference(y, x, c)
+    val gt = Literal.Difference(y, x, c - 1)
+    return when (op) {
+        LESS_THAN -> listOf(listOf(lt))
+        LESS_EQUAL -> listOf(listOf(le))
+        GREATER_THAN -> listOf(listOf(gt))
+        GREATER_EQUAL -> listOf(listOf(ge))
+        EQUAL -> listOf(listOf(le, ge))
+        NOT_EQUAL -> listOf(listOf(lt), listOf(gt))
+        else -> null
+    }
+}
+
+/**
+ * Literals of a [GuardTerm] of [literalTerms]: difference constraints where the arithmetic allows, opaque
+ * conditions otherwise.
+ */
+private fun Contract.literals(term: GuardTerm): List<Literal> = term.conditions.flatMap { condition ->
+    var expr = condition
+    var positive = true
+    while (expr is SUnaryExpression && expr.operator == SUnaryOperator.NEGATE) {
+        expr = expr.expr
+        positive = !positive
+    }
+    val comparison = (expr as? SBinaryExpression)?.takeIf { it.operator in negated }
+    //`!=` is a disjunction of differences and stays opaque
+    comparison?.let {
+        differences(it.left, if (positive) it.operator else negated.getValue(it.operator), it.right)?.singleOrNull()
+    } ?: listOf(Literal.Opaque(expr.toCExpr(), positive))
+} + term.atoms.flatMap { atom ->
+    val name = when (atom.ref.part) {
+        ClockPart.TOTAL -> atom.ref.clock
+        ClockPart.ENV -> envClockName(atom.ref.clock)
+        ClockPart.SYS -> sysClockName(atom.ref.clock)
+    }
+    differences(SVariable(name), atom.op, atom.bound)?.single() ?: listOf()
+}
+
+/**
+ * Bellman-Ford on the constraint graph: the conjunction is infeasible iff the graph has a negative cycle.
+ */
+private fun consistent(term: List<Literal>): Boolean {
+    val opaque = term.filterIsInstance<Literal.Opaque>()
+    if (opaque.any { l -> opaque.any { it.expr == l.expr && it.positive != l.positive } }) return false
+
+    val edges = term.filterIsInstance<Literal.Difference>()
+    val nodes = edges.flatMap { listOf(it.x, it.y) }.toSet()
+    val dist = nodes.associateWith { 0L }.toMutableMap()
+    repeat(nodes.size + 1) {
+        var changed = false
+        for ((x, y, c) in edges) {
+            if (dist.getValue(y) + c < dist.getValue(x)) {
+                dist[x] = dist.getValue(y) + c
+                changed = true
+            }
+        }
+        if (!changed) return true
+    }
+    return false
+}
+
+/**
+ * Whether all [guards] may hold at the same time. Integer arithmetic is only understood in the difference
+ * fragment, so `true` is returned whenever unsatisfiability cannot be shown.
+ */
+fun Contract.jointlySatisfiable(guards: List<SMVExpr>): Boolean {
+    if (guards.isEmpty()) return true
+    val terms = literalTerms(guards.reduce { acc, guard -> acc and guard }) ?: return true
+    return terms.any { consistent(literals(it)) }
+}
+
+/**
+ * Modes in which at most one transition can fire, as the pre- and postconditions of any two outgoing
+ * transitions are contradictory. A single token in such a mode has at most one successor.
+ */
+fun Contract.deterministicModes(): Set<String> = states.filter { mode ->
+    val outgoing = transitions.filter { it.from == mode }
+    outgoing.indices.all { i ->
+        (i + 1 until outgoing.size).none { j ->
+            jointlySatisfiable(listOf(outgoing[i], outgoing[j]).flatMap { listOf(it.contract.pre, it.contract.post) })
+        }
+    }
+}.toSet()
@@ -0,0 +1,100 @@
+package cagen.code
+
+import cagen.CATransition
+import cagen.Contract
+import cagen.code.CCodeUtilsSimplified.toCExpr
+import cagen.expr.*
+import cagen.expr.SBinaryOperator.*
+
+/**
+ * Decision tree over the atomic predicates of the guards leaving a mode. A [Leaf] lists the transitions whose
+ * precondition holds ([enabled]) and those of them whose postcondition holds as well ([fired]), by index.
+ */
+sealed class GuardTree {
+    data class Branch(val atom: SMVExpr, val then: GuardTree, val otherwise: GuardTree) : GuardTree()
+    data class Leaf(val enabled: List<Int>, val fired: List<Int>) : GuardTree()
+}
+
+/**
+ * Transitions enabled in some leaf of this tree.
+ */
+fun GuardTree.enabledTransitions(): Set<Int> = when (this) {
+    is GuardTree.Branch -> then.enabledTransitions() + otherwise.enabledTransitions()
+    is GuardTree.Leaf -> enabled.toSet()
+}
+
+/**
+ * Decision tree of the guards of [transitions] leaving a mode, only for guards without clock history since they
+ * cannot throw.
+ */
+fun Contract.guardTreeOf(transitions: List<CATransition>): GuardTree? =
+    if (transitions.size < 2 || transitions.any { mentionsClockHistory(it.contract.pre) || mentionsClockHistory(it.contract.post) }) null
+    else guardTree(transitions.map { it.contract.pre to it.contract.post })
+
+fun Contract.hasGuardTrees() = transitions.groupBy { it.from }.values.any { guardTreeOf(it) != null }
+
+private const val MAX_TREE_ATOMS = 6
+
+/**
+ * Value of [expr] under the atoms decided so far, evaluated with the short-circuit rules of C++: either a
+ * [Boolean] or the atom C++ would evaluate next.
+ */
+private fun partial(expr: SMVExpr, decided: Map<String, Boolean>): Any = when {
+    expr is SBooleanLiteral -> expr.value
+    expr is SUnaryExpression && expr.operator == SUnaryOperator.NEGATE ->
+        partial(expr.expr, decided).let { if (it is Boolean) !it else it }
+
+    expr is SBinaryExpression && expr.operator in setOf(AND, OR, IMPL) -> {
+        val left = partial(expr.left, decided)
+        when {
+            left !is Boolean -> left
+            expr.operator == AND && !left -> false
+            expr.operator == OR && left -> true
+            expr.operator == IMPL && !left -> true
+            else -> partial(expr.right, decided)
+        }
+    }
+
+    else -> decided[expr.toCExpr()] ?: expr
+}
+
+/**
+ * Decision tree of the [guards] (pre- and postcondition per transition) leaving a mode. Atoms are tested in the
+ * order the sequential evaluation of the guards would reach them, so every atom is evaluated at most once on a
+ * path and only where the sequential code would have evaluated it. Returns `null` if the guards have more than
+ * [MAX_TREE_ATOMS] atoms, which bounds the tree to `2^MAX_TREE_ATOMS` leaves.
+ */
+fun guardTree(guards: List<Pair<SMVExpr, SMVExpr>>): GuardTree? {
+    val atoms = guards.flatMap { (pre, post) -> listOf(pre, post) }.flatMap { it.atomicPredicates() }.distinct()
+    if (atoms.size > MAX_TREE_ATOMS) return null
+    return tree(guards, mapOf())
+}
+
+private fun tree(guards: List<Pair<SMVExpr, SMVExpr>>, decided: Map<String, Boolean>): GuardTree {
+    val enabled = mutableListOf<Int>()
+    val fired = mutableListOf<Int>()
+    for ((i, guard) in guards.withIndex()) {
+        for ((condition, into) in listOf(guard.first to enabled, guard.second to fired)) {
+            when (val value = partial(condition, decided)) {
+                true -> into += i
+                false -> break
+                else -> {
+                    val atom = value as SMVExpr
+                    val key = atom.toCExpr()
+                    return GuardTree.Branch(atom, tree(guards, decided + (key to true)), tree(guards, decided + (key to false)))
+                }
+            }
+        }
+    }
+    return GuardTree.Leaf(enabled, fired)
+}
+
+/**
+ * C expressions of the maximal subexpressions of this below the boolean connectives.
+ */
+fun SMVExpr.atomicPredicates(): List<String> = when {
+    this is SBooleanLiteral -> listOf()
+    this is SUnaryExpression && operator == SUnaryOperator.NEGATE -> expr.atomicPredicates()
+    this is SBinaryExpression && operator in setOf(AND, OR, IMPL) -> left.atomicPredicates() + right.atomicPredicates()
+    else -> listOf(toCExpr())
+}
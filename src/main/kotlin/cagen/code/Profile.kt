@@ -0,0 +1,90 @@
+package cagen.code
+
+import cagen.CATransition
+import cagen.Contract
+
+/**
+ * How often a transition was evaluated (a token was in its source mode), enabled (its precondition held) and
+ * fired (both guards held) while a monitor built with PROFILE_MONITOR ran.
+ */
+data class TransitionCounts(val visits: Long, val enabled: Long, val fired: Long)
+
+/**
+ * Profile written by monitors built with PROFILE_MONITOR: one line `contract transitions index visits enabled fired`
+ * per transition, `index` being the position of the transition among the `transitions` of the profiled monitor.
+ * Profiles of several runs or contracts can be concatenated, their counts are added up.
+ */
+class MonitorProfile(
+    private val counts: Map<String, Map<Int, TransitionCounts>>,
+    private val transitions: Map<String, Int> = mapOf()
+) {
+    /**
+     * Counts of [transition], `null` if it was not profiled. Indices only match a monitor with the same transitions,
+     * so a profile of a monitor pruned differently than [contract] is rejected.
+     */
+    fun counts(contract: Contract, transition: CATransition): TransitionCounts? {
+        val profiled = counts[contract.name] ?: return null
+        val recorded = transitions[contract.name]
+        require(recorded == null || recorded == contract.transitions.size) {
+            "Profile of ${contract.name} was recorded with $recorded transitions, the monitor has " +
+                "${contract.transitions.size}; profile a monitor generated with the same --keep-dead-code setting"
+        }
+        return profiled[contract.transitions.indexOfFirst { it === transition }]
+    }
+
+    /**
+     * [transitions] leaving a mode, most frequently fired first. Unprofiled transitions keep their order at the end.
+     */
+    fun order(contract: Contract, transitions: List<CATransition>): List<CATransition> =
+        transitions.sortedWith(compareByDescending<CATransition> { counts(contract, it)?.fired ?: -1 }
+            .thenByDescending { counts(contract, it)?.enabled ?: -1 })
+
+    /**
+     * `true` if the precondition of [transition] held in at least [BIAS] of its evaluations, `false` if in at most
+     * `1 - BIAS`, `null` if it is not biased or was not evaluated.
+     */
+    fun likely(contract: Contract, transition: CATransition): Boolean? {
+        val c = counts(contract, transition) ?: return null
+        if (c.visits == 0L) return null
+        val rate = c.enabled.toDouble() / c.visits
+        return when {
+            rate >= BIAS -> true
+            rate <= 1 - BIAS -> false
+            else -> null
+        }
+    }
+
+    /**
+     * Hint for the atom of [branch] in the guard tree of [transitions]: a transition whose precondition is likely and
+     * that is only enabled on one side makes that side likely, `null` if there is no such transition or they disagree.
+     */
+    fun likely(contract: Contract, transitions: List<CATransition>, branch: GuardTree.Branch): Boolean? {
+        val then = branch.then.enabledTransitions()
+        val otherwise = branch.otherwise.enabledTransitions()
+        return (then + otherwise).filter { likely(contract, transitions[it]) == true }
+            .mapNotNull { if (it !in otherwise) true else if (it !in then) false else null }
+            .toSet().singleOrNull()
+    }
+
+    companion object {
+        private const val BIAS = 0.9
+
+        fun parse(lines: List<String>): MonitorProfile {
+            val counts = mutableMapOf<String, MutableMap<Int, TransitionCounts>>()
+            val transitions = mutableMapOf<String, Int>()
+            for (line in lines.map { it.trim() }.filter { it.isNotEmpty() && !it.startsWith("#") }) {
+                val fields = line.split(Regex("\\s+"))
+                require(fields.size == 6) { "Malformed profile line: $line" }
+                val size = fields[1].toInt()
+                require(transitions.getOrPut(fields[0]) { size } == size) {
+                    "Profiles of ${fields[0]} with ${transitions[fields[0]]} and $size transitions cannot be combined"
+                }
+                val (visits, enabled, fired) = fields.drop(3).map { it.toLong() }
+                counts.getOrPut(fields[0]) { mutableMapOf() }.merge(
+                    fields[2].toInt(), TransitionCounts(visits, enabled, fired)
+                ) { a, b -> TransitionCounts(a.visits + b.visits, a.enabled + b.enabled, a.fired + b.fired) }
+            }
+            return MonitorProfile(counts, transitions)
+        }
+    }
+}
@@ -0,0 +1,67 @@
+package cagen.code
+
+import cagen.CATransition
+import cagen.Contract
+import cagen.expr.SIntegerLiteral
+import cagen.expr.SMVExpr
+import cagen.expr.SVariable
+
+/**
+ * Value ranges of the integer types narrower than `int`.
+ */
+private val TYPE_RANGES = mapOf(
+    "int8" to -128L..127L,
+    "int16" to -32768L..32767L,
+    "short" to -32768L..32767L,
+)
+
+/**
+ * Facts the guards of this may assume about [names]: clocks and their parts are never negative and narrow
+ * integers stay within their type.
+ */
+private fun Contract.rangeFacts(names: Set<String>): List<SMVExpr> = names.flatMap { name ->
+    val range = TYPE_RANGES[signature.get(name)?.type?.name]
+    when {
+        clockRef(name) != null -> listOf(SVariable(name) ge SIntegerLiteral(0.toBigInteger()))
+        range != null -> listOf(
+            SVariable(name) ge SIntegerLiteral(range.first.toBigInteger()),
+            SVariable(name) le SIntegerLiteral(range.last.toBigInteger())
+        )
+
+        else -> listOf()
+    }
+}
+
+/**
+ * Whether the precondition of [transition] can never hold under the integer [constants]. History entries are left
+ * alone, with NOEXCEPT_TRACE_ACCESS an undefined entry does not make a contradiction false.
+ */
+fun Contract.neverEnabled(transition: CATransition, constants: Map<String, Long> = mapOf()): Boolean {
+    val pre = transition.contract.pre.clone().replaceExhaustive(
+        constants.map { (name, value) -> SVariable(name) to SIntegerLiteral(value.toBigInteger()) }.toMap()
+    )
+    val names = pre.variableNames()
+    if (names.any { signature.get(it) == null && clockRef(it) == null }) return false
+    return !jointlySatisfiable(listOf(pre) + rangeFacts(names))
+}
+
+/**
+ * Copy of this without the transitions that can never fire a token, so that neither their code nor tokens of
+ * unreachable modes are emitted:
+ * - transitions whose precondition is unsatisfiable,
+ * - transitions repeating an earlier one with the same modes, guards and resets,
+ * - transitions leaving modes that no initial mode reaches.
+ * [constants] are the values of global defines. Returns this if no transition would remain.
+ */
+fun Contract.pruned(constants: Map<String, Long> = mapOf()): Contract {
+    val live = transitions.filter { !neverEnabled(it, constants) }
+        .distinctBy { listOf(it.from, it.to, it.vvGuard, it.contract.pre, it.contract.post, it.clocks.toSet()) }
+    val reachable = states.filter { it[0].isLowerCase() }.toMutableSet()
+    var frontier = reachable.toList()
+    while (frontier.isNotEmpty()) {
+        frontier = live.filter { it.from in frontier }.map { it.to }.filter { reachable.add(it) }
+    }
+    val kept = live.filter { it.from in reachable }
+    if (kept.size == transitions.size || kept.isEmpty()) return this
+    return copy(transitions = kept).also { it.disabledTransitions = disabledTransitions }
+}
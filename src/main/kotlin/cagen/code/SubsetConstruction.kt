@@ -0,0 +1,129 @@
+package cagen.code
+
+import cagen.Contract
+import cagen.code.CCodeUtilsSimplified.toCExpr
+import cagen.expr.*
+import cagen.expr.SBinaryOperator.*
+
+/**
+ * Outcome of a step of the marking: the monitor keeps running or one of the players has lost.
+ */
+enum class Verdict { NONE, ENVIRONMENT_LOSES, SYSTEM_LOSES }
+
+/**
+ * Minimal DFA over the markings of a clockless contract. The input of a step is the truth vector of the
+ * atomic [predicates], bit `i` being the value of `predicates[i]`. [next] maps a state and a truth vector to the
+ * successor state, [verdicts] gives the verdict reached when entering a state. State 0 is the initial state.
+ * States with a verdict are sinks: their marking is empty.
+ */
+class MarkingDfa(val predicates: List<SMVExpr>, val next: List<IntArray>, val verdicts: List<Verdict>) {
+    val size: Int get() = next.size
+}
+
+private const val MAX_DFA_PREDICATES = 12
+
+/**
+ * Atomic predicates of [expr]: the maximal subexpressions below the boolean connectives, identified by their
+ * C expression.
+ */
+private fun atoms(expr: SMVExpr, into: MutableMap<String, SMVExpr>) {
+    when {
+        expr is SBooleanLiteral -> {}
+        expr is SUnaryExpression && expr.operator == SUnaryOperator.NEGATE -> atoms(expr.expr, into)
+        expr is SBinaryExpression && expr.operator in setOf(AND, OR, IMPL) -> {
+            atoms(expr.left, into)
+            atoms(expr.right, into)
+        }
+
+        else -> into.putIfAbsent(expr.toCExpr(), expr)
+    }
+}
+
+private fun evaluate(expr: SMVExpr, index: Map<String, Int>, vector: Int): Boolean = when {
+    expr is SBooleanLiteral -> expr.value
+    expr is SUnaryExpression && expr.operator == SUnaryOperator.NEGATE -> !evaluate(expr.expr, index, vector)
+    expr is SBinaryExpression && expr.operator == AND ->
+        evaluate(expr.left, index, vector) && evaluate(expr.right, index, vector)
+
+    expr is SBinaryExpression && expr.operator == OR ->
+        evaluate(expr.left, index, vector) || evaluate(expr.right, index, vector)
+
+    expr is SBinaryExpression && expr.operator == IMPL ->
+        !evaluate(expr.left, index, vector) || evaluate(expr.right, index, vector)
+
+    else -> vector shr index.getValue(expr.toCExpr()) and 1 == 1
+}
+
+/**
+ * Subset construction over the markings of a clockless contract followed by Moore minimisation with respect to
+ * the verdicts. Returns `null` if the contract reads a clock, has more than [MAX_DFA_PREDICATES] atomic predicates,
+ * or if the transition table would have more than [maxEntries] entries.
+ */
+fun Contract.markingDfa(maxEntries: Int): MarkingDfa? {
+    if (!isClockless()) return null
+    val atoms = linkedMapOf<String, SMVExpr>()
+    transitions.forEach {
+        atoms(it.contract.pre, atoms)
+        atoms(it.contract.post, atoms)
+    }
+    if (atoms.size > MAX_DFA_PREDICATES) return null
+    val index = atoms.keys.withIndex().associate { (i, key) -> key to i }
+    val vectors = 1 shl atoms.size
+    if (vectors > maxEntries) return null
+
+    //guards of every transition under every truth vector
+    val pre = transitions.map { t -> BooleanArray(vectors) { evaluate(t.contract.pre, index, it) } }
+    val post = transitions.map { t -> BooleanArray(vectors) { evaluate(t.contract.post, index, it) } }
+
+    //markings, the empty marking is split into the two sinks
+    val markings = mutableListOf<Set<String>>()
+    val verdicts = mutableListOf<Verdict>()
+    val ids = mutableMapOf<Pair<Set<String>, Verdict>, Int>()
+    val next = mutableListOf<IntArray>()
+    fun id(marking: Set<String>, verdict: Verdict): Int = ids.getOrPut(marking to verdict) {
+        markings += marking
+        verdicts += verdict
+        markings.size - 1
+    }
+
+    id(states.filter { it[0].isLowerCase() }.toSet(), Verdict.NONE)
+    var current = 0
+    while (current < markings.size) {
+        if (markings.size.toLong() * vectors > maxEntries) return null
+        val marking = markings[current]
+        next += IntArray(vectors) { v ->
+            val enabled = transitions.indices.filter { transitions[it].from in marking && pre[it][v] }
+            val successors = enabled.filter { post[it][v] }.map { transitions[it].to }.toSet()
+            when {
+                verdicts[current] != Verdict.NONE -> current
+                enabled.isEmpty() -> id(setOf(), Verdict.ENVIRONMENT_LOSES)
+                successors.isEmpty() -> id(setOf(), Verdict.SYSTEM_LOSES)
+                else -> id(successors, Verdict.NONE)
+            }
+        }
+        current++
+    }
+    return minimise(atoms.values.toList(), next, verdicts)
+}
+
+private fun minimise(predicates: List<SMVExpr>, next: List<IntArray>, verdicts: List<Verdict>): MarkingDfa {
+    var block = verdicts.map { it.ordinal }.toIntArray()
+    while (true) {
+        val signatures = mutableMapOf<List<Int>, Int>()
+        val refined = IntArray(next.size) { s ->
+            val signature = listOf(block[s]) + next[s].map { block[it] }
+            signatures.getOrPut(signature) { signatures.size }
+        }
+        if (signatures.size == block.distinct().size) break
+        block = refined
+    }
+    //renumber the blocks in order of first occurrence so that the initial state stays 0
+    val order = block.distinct()
+    val number = order.withIndex().associate { (i, b) -> b to i }
+    val representatives = order.map { b -> block.indexOfFirst { it == b } }
+    return MarkingDfa(
+        predicates,
+        representatives.map { s -> IntArray(next[s].size) { number.getValue(block[next[s][it]]) } },
+        representatives.map { verdicts[it] }
+    )
+}
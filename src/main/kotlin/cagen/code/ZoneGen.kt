@@ -0,0 +1,314 @@
+package cagen.code
+
+import cagen.CATransition
+import cagen.Contract
+import cagen.code.CCodeUtilsSimplified.toCExpr
+import cagen.expr.SBinaryOperator.*
+
+/**
+ * Symbolic token engine, enabled with `ZONES`. A token is a mode together with a zone, a difference bound matrix
+ * over the clocks of the contract. Every clock `x` occupies two dimensions, its total value `x` and its
+ * environment part `x_e`; the system part `x_s` is the difference of both.
+ * Tokens whose zone is included in the zone of another token in the same mode are subsumed.
+ */
+object ZoneGen {
+    fun isSupported(contract: Contract) = contract.transitions.all {
+        contract.guardTerms(it.contract.pre) != null && contract.guardTerms(it.contract.post) != null
+    }
+
+    private fun dimensions(contract: Contract) = 1 + 2 * contract.baseClocks.size
+
+    private fun totalDim(contract: Contract, clock: String) = 1 + 2 * contract.baseClocks.indexOf(clock)
+    private fun envDim(contract: Contract, clock: String) = 2 + 2 * contract.baseClocks.indexOf(clock)
+
+    //the constrained value is the difference of the two dimensions
+    private fun dims(contract: Contract, ref: ClockRef) = when (ref.part) {
+        ClockPart.TOTAL -> totalDim(contract, ref.clock) to 0
+        ClockPart.ENV -> envDim(contract, ref.clock) to 0
+        ClockPart.SYS -> totalDim(contract, ref.clock) to envDim(contract, ref.clock)
+    }
+
+    /**
+     * Expressions for the smallest and largest value of a clock part in the zone of `tok`.
+     */
+    fun partBounds(contract: Contract, ref: ClockRef): Pair<String, String> {
+        val (pos, neg) = dims(contract, ref)
+        return "-tok.zone.bound($neg, $pos)" to "tok.zone.bound($pos, $neg)"
+    }
+
+    private fun constrain(contract: Contract, zone: String, atom: ClockAtom): String {
+        val (pos, neg) = dims(contract, atom.ref)
+        val bound = "(${atom.bound.toCExpr()})"
+        return when (atom.op) {
+            LESS_EQUAL -> "$zone.constrain($pos, $neg, $bound);"
+            LESS_THAN -> "$zone.constrain($pos, $neg, $bound - 1);"
+            GREATER_EQUAL -> "$zone.constrain($neg, $pos, -$bound);"
+            GREATER_THAN -> "$zone.constrain($neg, $pos, -$bound - 1);"
+            else -> error("unexpected clock comparison ${atom.op}")
+        }
+    }
+
+    private fun condition(term: GuardTerm) =
+        if (term.conditions.isEmpty()) "true" else term.conditions.joinToString(" && ") { it.toCExpr() }
+
+    fun declarations(contract: Contract): String {
+        val name = contract.name
+        val maxConstants = contract.maxConstants()
+        if (!isSupported(contract)) {
+            return """
+            #ifdef ZONES
+            #error "$name compares clocks outside of the difference bound fragment, ZONES is not available"
+            #endif"""
+        }
+        return """
+            #ifdef ZONES
+            #ifdef FUZZY
+            #error "ZONES cannot be combined with FUZZY"
+            #endif
+            #include "dbm${CppGen.headerExtension}"
+            
+            constexpr std::size_t zone_dimensions = ${dimensions(contract)};
+            inline char const* const zone_dimension_names[] = {"0", ${
+                contract.baseClocks.joinToString(", ") { "\"$it\", \"${envClockName(it)}\"" }}};
+            //clocks whose system part is constrained are never extrapolated
+            constexpr std::array<int, zone_dimensions> zone_max_constants = {-1, ${
+                contract.baseClocks.joinToString(", ") {
+                    val k = if (maxConstants[it]?.diagonal == false) "clock_max_constant(ClockId::$it)" else "-1"
+                    "$k, $k"
+                }}};
+            
+            struct ${getZoneTokenName(name)} {
+                ${getModeName(name)} mode;
+                dbm<zone_dimensions> zone;
+            };
+            using ZoneToksT = std::vector<${getZoneTokenName(name)}>;
+            
+            //adds the token unless it is subsumed, drops the tokens it subsumes
+            inline void zone_insert(ZoneToksT& toks, ${getZoneTokenName(name)} tok) {
+                for(auto const& other : toks) {
+                    if(other.mode == tok.mode && other.zone.includes(tok.zone)) return;
+                }
+                toks.erase(std::remove_if(toks.begin(), toks.end(), [&tok](auto const& other) {
+                    return other.mode == tok.mode && tok.zone.includes(other.zone);
+                }), toks.end());
+                toks.push_back(std::move(tok));
+            }
+            #endif"""
+    }
+
+    fun initialTokens(contract: Contract, initialModes: List<String>) =
+        initialModes.joinToString(", ") { "${getZoneTokenName(contract.name)}{${getModeName(contract.name)}::$it, {}}" }
+
+    fun advanceBody(contract: Contract): String {
+        val shift = listOf("0") + contract.baseClocks.flatMap { listOf("t_e + t_s", "t_e") }
+        return """
+                for(auto& tok : tokens) {
+                    tok.zone.shift({${shift.joinToString(", ")}});
+                }"""
+    }
+
+    fun updateBody(contract: Contract): String {
+        val modeName = getModeName(contract.name)
+        return """
+                ZoneToksT next_tokens;
+                bool any_pre = false;
+                for(auto const& tok : tokens) {
+                    switch(tok.mode) {
+                        ${contract.transitions.groupBy { it.from }.toList().joinToString("""
+                        """) { (from, transitions) -> "case $modeName::$from: {" +
+                            transitions.joinToString("") { fire(contract, it) } + """
+                            break;
+                        }"""
+                        }}
+                        default: break;
+                    }
+                }
+                tokens = std::move(next_tokens);"""
+    }
+
+    private fun fire(contract: Contract, transition: CATransition): String {
+        val pre = contract.guardTerms(transition.contract.pre)!!
+        val post = contract.guardTerms(transition.contract.post)!!
+        val resets = transition.clocks.filter { it in contract.baseClocks }
+        return pre.joinToString("") { preTerm -> """
+                            if(${condition(preTerm)}) {
+                                auto pre_zone = tok.zone;
+                                ${preTerm.atoms.joinToString("\n                                ") { constrain(contract, "pre_zone", it) }}
+                                if(!pre_zone.is_empty()) {
+                                    any_pre = true;""" +
+            post.joinToString("") { postTerm -> """
+                                    if(${condition(postTerm)}) {
+                                        auto post_zone = pre_zone;
+                                        ${postTerm.atoms.joinToString("\n                                        ") { constrain(contract, "post_zone", it) }}
+                                        if(!post_zone.is_empty()) {
+                                            ${resets.joinToString("\n                                            ") {
+                                                "post_zone.reset(${totalDim(contract, it)});\n                                            post_zone.reset(${envDim(contract, it)});"
+                                            }}
+                                            #if(EXTRAPOLATE_CLOCKS)
+                                            post_zone.extrapolate(zone_max_constants);
+                                            #endif
+                                            zone_insert(next_tokens, ${getZoneTokenName(contract.name)}{$modeName::${transition.to}, std::move(post_zone)});
+                                        }
+                                    }"""
+            } + """
+                                }
+                            }"""
+        }
+    }
+
+    fun printTokens(contract: Contract) = """
+                for(auto const& tok : monitor.tokens) {
+                    out << "      " << tok.mode << "\n        ";
+                    tok.zone.print(out, zone_dimension_names);
+                    out << "\n";
+                }"""
+}
+
+internal const val dbmCode = """
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <iostream>
+
+//difference bound matrix over integer clocks
+//entry (i,j) is the least upper bound of x_i - x_j, dimension 0 is the constant zero
+template<std::size_t N>
+class dbm {
+public:
+    static constexpr int infinity = INT_MAX;
+
+    //the zone containing only the valuation where all clocks are zero
+    dbm() noexcept {
+        for(auto& row : m_) row.fill(0);
+    }
+
+    [[nodiscard]] int bound(std::size_t i, std::size_t j) const { return m_[i][j]; }
+
+    [[nodiscard]] bool is_empty() const {
+        return m_[0][0] < 0;
+    }
+
+    //intersect with x_i - x_j <= c and restore canonical form
+    void constrain(std::size_t i, std::size_t j, int c) {
+        if(is_empty() || c >= m_[i][j]) return;
+        if(add(c, m_[j][i]) < 0) {
+            m_[0][0] = -1;
+            return;
+        }
+        m_[i][j] = c;
+        for(std::size_t k = 0; k < N; ++k) {
+            for(std::size_t l = 0; l < N; ++l) {
+                auto via = add(add(m_[k][i], c), m_[j][l]);
+                if(via < m_[k][l]) m_[k][l] = via;
+            }
+        }
+    }
+
+    //widens every bound beyond the maximal constant k_i of its clocks, k_i < 0 leaves dimension i untouched
+    void extrapolate(std::array<int, N> const& k) {
+        if(is_empty()) return;
+        for(std::size_t i = 0; i < N; ++i) {
+            for(std::size_t j = 0; j < N; ++j) {
+                if(i == j) continue;
+                if(i != 0 && k[i] >= 0 && m_[i][j] != infinity && m_[i][j] > k[i]) {
+                    m_[i][j] = infinity;
+                } else if(j != 0 && k[j] >= 0 && m_[i][j] < -k[j]) {
+                    m_[i][j] = -k[j] - 1;
+                }
+            }
+        }
+        close();
+    }
+
+    //smallest zone containing both, canonical if both are
+    void join(dbm const& other) {
+        if(other.is_empty()) return;
+        if(is_empty()) {
+            *this = other;
+            return;
+        }
+        for(std::size_t i = 0; i < N; ++i) {
+            for(std::size_t j = 0; j < N; ++j) {
+                m_[i][j] = std::max(m_[i][j], other.m_[i][j]);
+            }
+        }
+    }
+
+    //x_i := 0
+    void reset(std::size_t i) {
+        for(std::size_t j = 0; j < N; ++j) {
+            m_[i][j] = m_[0][j];
+            m_[j][i] = m_[j][0];
+        }
+        m_[i][i] = 0;
+    }
+
+    //x_i := x_i + d_i for every clock, d_0 has to be zero
+    void shift(std::array<int, N> const& d) {
+        for(std::size_t i = 0; i < N; ++i) {
+            for(std::size_t j = 0; j < N; ++j) {
+                if(m_[i][j] != infinity) m_[i][j] += d[i] - d[j];
+            }
+        }
+    }
+
+    [[nodiscard]] bool includes(dbm const& other) const {
+        if(other.is_empty()) return true;
+        if(is_empty()) return false;
+        for(std::size_t i = 0; i < N; ++i) {
+            for(std::size_t j = 0; j < N; ++j) {
+                if(other.m_[i][j] > m_[i][j]) return false;
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool operator==(dbm const& rhs) const { return m_ == rhs.m_; }
+    [[nodiscard]] bool operator<(dbm const& rhs) const { return m_ < rhs.m_; }
+
+    //prints the interval of every clock, differences are omitted
+    void print(std::ostream& out, char const* const* names) const {
+        if(is_empty()) {
+            out << "{}";
+            return;
+        }
+        out << "{";
+        for(std::size_t i = 1; i < N; ++i) {
+            if(i > 1) out << ", ";
+            if(m_[i][0] == -m_[0][i]) {
+                out << names[i] << "=" << m_[i][0];
+            } else if(m_[i][0] == infinity) {
+                out << names[i] << ">=" << -m_[0][i];
+            } else {
+                out << -m_[0][i] << "<=" << names[i] << "<=" << m_[i][0];
+            }
+        }
+        out << "}";
+    }
+
+private:
+    std::array<std::array<int, N>, N> m_;
+
+    //Floyd-Warshall, restores canonical form after several bounds changed
+    void close() {
+        for(std::size_t k = 0; k < N; ++k) {
+            for(std::size_t i = 0; i < N; ++i) {
+                for(std::size_t j = 0; j < N; ++j) {
+                    auto via = add(m_[i][k], m_[k][j]);
+                    if(via < m_[i][j]) m_[i][j] = via;
+                }
+            }
+        }
+        for(std::size_t i = 0; i < N; ++i) {
+            if(m_[i][i] < 0) m_[0][0] = -1;
+        }
+    }
+
+    static int add(int a, int b) {
+        if(a == infinity || b == infinity) return infinity;
+        return a + b;
+    }
+};
+
+"""
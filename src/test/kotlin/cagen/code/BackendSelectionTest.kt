@@ -0,0 +1,67 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class BackendSelectionTest {
+    private fun load(code: String) = ParserFacade.loadFile(CharStreams.fromString(code.trimIndent())).contracts.first()
+
+    @Test
+    fun deterministicContract() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+
+                m -> m :: a ==> x < 3
+                m -> N :: !a ==> true # x
+                N -> m :: true ==> x >= 5
+            }
+            """
+        )
+        val backend = contract.selectBackend()
+        assertThat(backend.defines).containsOnlyKeys("RINGBUFFER")
+        assertThat(backend.facts).contains("deterministic" to "true", "worst-case marking" to "1 token")
+    }
+
+    @Test
+    fun nonDeterministicContract() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+
+                m -> m :: a ==> x < 3
+                m -> n :: a ==> true # x
+                n -> m :: true ==> x >= 5
+            }
+            """
+        )
+        assertThat(contract.tokenBound()).isEqualTo(98.toBigInteger())
+        val backend = contract.selectBackend()
+        assertThat(backend.defines).containsOnlyKeys("ADAPTIVE_TOKENS", "DEDUPLICATE_TOKENS", "RINGBUFFER")
+        assertThat(backend.report(contract)).contains("DEDUPLICATE_TOKENS defined", "ADAPTIVE_TOKENS defined", "FUZZY unset")
+    }
+
+    @Test
+    fun deepClockHistory() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+                history x(16)
+
+                m -> m :: a ==> h_x_16 < 3
+                m -> n :: a ==> true # x
+            }
+            """
+        )
+        assertThat(contract.tokenBound()).isNull()
+        assertThat(contract.selectBackend().defines).containsOnlyKeys("ADAPTIVE_TOKENS", "DEDUPLICATE_TOKENS", "SHARED_TRACES")
+    }
+}
@@ -0,0 +1,67 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class BitSlicingTest {
+    private fun load(code: String) = ParserFacade.loadFile(CharStreams.fromString(code.trimIndent())).contracts.first()
+
+    @Test
+    fun booleanGuards() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                input b : bool
+
+                m -> m :: a & !b ==> a | !b
+                m -> n :: a != b ==> true
+            }
+            """
+        )
+        val transitions = contract.transitions
+        assertThat(contract.bitSliced(transitions[0].contract.pre)).isEqualTo("(a & ~b)")
+        assertThat(contract.bitSliced(transitions[0].contract.post)).isEqualTo("(a | ~b)")
+        assertThat(contract.bitSliced(transitions[1].contract.pre)).isEqualTo("(a ^ b)")
+        assertThat(contract.bitSliced(transitions[1].contract.post)).isEqualTo("slice::all()")
+        assertThat(contract.isBitSliceable()).isTrue()
+    }
+
+    @Test
+    fun arithmeticAndClocksAreNotSliced() {
+        val contract = load(
+            """
+            contract D {
+                input a : bool
+                input d : int
+                clock x : int
+
+                m -> m :: a & d > 2 ==> true
+                m -> m :: a ==> x < 3
+            }
+            """
+        )
+        val transitions = contract.transitions
+        assertThat(contract.bitSliced(transitions[0].contract.pre)).isNull()
+        assertThat(contract.bitSliced(transitions[1].contract.post)).isNull()
+        assertThat(contract.isBitSliceable()).isFalse()
+    }
+
+    @Test
+    fun unreadIntegersHaveNoSlice() {
+        val contract = load(
+            """
+            contract E {
+                input a : bool
+                output d : int
+
+                m -> m :: a ==> !a
+            }
+            """
+        )
+        assertThat(contract.isBitSliceable()).isTrue()
+        assertThat(contract.bitSlicedVariables().map { it.name }).containsExactly("a")
+    }
+}
@@ -0,0 +1,137 @@
+package cagen.code
+
+import cagen.ParserFacade
+import cagen.expr.SBinaryOperator
+import cagen.expr.SVariable
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class ClockConstraintsTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input a : bool
+                output d : int
+                clock x : int
+                clock y : int
+                history y(1)
+
+                m -> m :: a & x < d ==> !(x_s >= 3 | a) # x
+                m -> n :: x = d ==> true
+                n -> n :: x + y < 3 ==> h_y_1 > 2
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    private val transitions = contract.transitions
+
+    @Test
+    fun clockReferences() {
+        assertThat(contract.clockRef("x")).isEqualTo(ClockRef("x", ClockPart.TOTAL))
+        assertThat(contract.clockRef("x_e")).isEqualTo(ClockRef("x", ClockPart.ENV))
+        assertThat(contract.clockRef("y_s")).isEqualTo(ClockRef("y", ClockPart.SYS))
+        assertThat(contract.clockRef("d")).isNull()
+        assertThat(contract.isClockHistoryAccess("h_y_1")).isTrue()
+        assertThat(contract.isClockHistoryAccess("h_x_1")).isFalse()
+    }
+
+    @Test
+    fun conjunctionWithNegatedDisjunction() {
+        val pre = contract.guardTerms(transitions[0].contract.pre)!!
+        assertThat(pre).hasSize(1)
+        assertThat(pre[0].conditions).hasSize(1)
+        assertThat(pre[0].atoms.map { it.ref to it.op })
+            .containsExactly(ClockRef("x", ClockPart.TOTAL) to SBinaryOperator.LESS_THAN)
+
+        val post = contract.guardTerms(transitions[0].contract.post)!!
+        assertThat(post).hasSize(1)
+        assertThat(post[0].atoms.map { it.ref to it.op })
+            .containsExactly(ClockRef("x", ClockPart.SYS) to SBinaryOperator.LESS_THAN)
+    }
+
+    @Test
+    fun equalityIsSplitIntoBounds() {
+        val pre = contract.guardTerms(transitions[1].contract.pre)!!
+        assertThat(pre).hasSize(1)
+        assertThat(pre[0].atoms.map { it.op })
+            .containsExactly(SBinaryOperator.LESS_EQUAL, SBinaryOperator.GREATER_EQUAL)
+        assertThat(contract.guardTerms(transitions[1].contract.post)!!.single().atoms).isEmpty()
+    }
+
+    @Test
+    fun unsupportedClockUsage() {
+        assertThat(contract.guardTerms(transitions[2].contract.pre)).isNull()
+        assertThat(contract.guardTerms(transitions[2].contract.post)).isNull()
+        assertThat(ZoneGen.isSupported(contract)).isFalse()
+    }
+
+    @Test
+    fun literalTermsSplitClockFreeConditions() {
+        val excludedMiddle = SVariable("a") or !SVariable("a")
+        assertThat(contract.guardTerms(excludedMiddle)).hasSize(1)
+        assertThat(contract.literalTerms(excludedMiddle)!!.map { it.conditions.single() }).hasSize(2)
+        val pre = contract.literalTerms(transitions[2].contract.pre)!!
+        assertThat(pre.single().conditions).hasSize(1)
+        assertThat(pre.single().atoms).isEmpty()
+    }
+
+    @Test
+    fun clockHistoryAccess() {
+        assertThat(contract.mentionsClockHistory(transitions[2].contract.post)).isTrue()
+        assertThat(contract.mentionsClockHistory(transitions[2].contract.pre)).isFalse()
+        assertThat(contract.clockHistoryOnlyInOperators(transitions[2].contract.post)).isTrue()
+        assertThat(contract.hasClockHistory()).isTrue()
+    }
+
+    @Test
+    fun maximalConstants() {
+        val bounded = ParserFacade.loadFile(
+            CharStreams.fromString(
+                """
+                contract D {
+                    input a : bool
+                    output d : int
+                    clock x : int
+                    clock y : int
+
+                    m -> m :: a & x < d ==> !(x_s >= 3 | a) # x
+                    m -> n :: x = 7 ==> y_e > 2
+                }
+                """.trimIndent()
+            )
+        ).contracts.first()
+        val max = bounded.maxConstants()
+        assertThat(max.getValue("x")!!.constants.map { it.toInt() }).containsExactly(3, 7, 7)
+        assertThat(max.getValue("x")!!.variables).containsExactly("d")
+        assertThat(max.getValue("x")!!.diagonal).isTrue()
+        assertThat(max.getValue("y")).isEqualTo(MaxConstant(listOf(2.toBigInteger())))
+        assertThat(contract.maxConstants().getValue("x")).isNull()
+        assertThat(bounded.indexKey()).isEqualTo(ClockRef("x", ClockPart.TOTAL))
+        assertThat(bounded.hasClockHistory()).isFalse()
+        assertThat(bounded.skippableSteps()).isTrue()
+        assertThat(contract.skippableSteps()).isFalse()
+    }
+
+    @Test
+    fun clocklessGuards() {
+        val untimed = ParserFacade.loadFile(
+            CharStreams.fromString(
+                """
+                contract E {
+                    input a : bool
+                    clock x : int
+
+                    m -> n :: a ==> true # x
+                    n -> m :: !a ==> a | !a
+                }
+                """.trimIndent()
+            )
+        ).contracts.first()
+        assertThat(untimed.isClockless()).isTrue()
+        assertThat(untimed.indexKey()).isNull()
+        assertThat(contract.isClockless()).isFalse()
+    }
+}
@@ -0,0 +1,44 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class ClockLivenessTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+                clock x_e : int
+                clock x_s : int
+                clock y : int
+                clock t : int
+                clock t_e : int
+                clock t_s : int
+                history y(3)
+                history a(2)
+
+                m -> m :: a & x_e < 3 ==> h_y_2 > 1 # x # t
+                m -> n :: true ==> true # y # t
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    @Test
+    fun readClocks() {
+        assertThat(contract.clockReads()).isEqualTo(mapOf("x" to 0, "y" to 2))
+    }
+
+    @Test
+    fun unusedClocksAreRemoved() {
+        val pruned = contract.withoutUnusedClocks()
+        assertThat(pruned.signature.clocks.map { it.name }).containsExactly("x", "x_e", "y")
+        assertThat(pruned.history).containsExactly("y" to 2, "a" to 2)
+        assertThat(pruned.transitions.map { it.clocks }).containsExactly(listOf("x"), listOf("y"))
+        assertThat(contract.transitions.map { it.clocks }).containsExactly(listOf("x", "t"), listOf("y", "t"))
+    }
+}
@@ -0,0 +1,83 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class DifferentialTest {
+    private fun load(code: String) = ParserFacade.loadFile(CharStreams.fromString(code.trimIndent())).contracts.first()
+
+    @Test
+    fun variantsOfATimedContract() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+
+                m -> m :: a ==> x < 3
+                m -> n :: a ==> true # x
+                n -> m :: x >= 5 ==> true
+            }
+            """
+        )
+        val variants = MonitorPlan(contract).engineVariants()
+        assertThat(variants.first()).isEqualTo(EngineVariant("variant_reference", variants.first().defines, null))
+        assertThat(variants.last()).isEqualTo(EngineVariant("variant_generated", listOf("DISPLAY_TRACES=0")))
+        assertThat(variants.map { it.name }).contains(
+            "variant_dedup", "variant_ringbuffer", "variant_ringbuffer_dedup", "variant_unbounded_trace",
+            "variant_unbounded_trace_dedup", "variant_fuzzy", "variant_clock_index", "variant_timestamp_clocks",
+            "variant_extrapolate_clocks", "variant_guard_trees", "variant_single_token", "variant_skip_unchanged_steps"
+        ).doesNotHaveDuplicates().doesNotContain("variant_error_trace_access", "variant_noexcept_trace_access")
+        assertThat(variants.drop(1)).allMatch { it.reference == "variant_reference" }
+        val reference = variants.first().defines
+        assertThat(reference).contains("MANUAL_BACKEND", "SINGLE_TOKEN=0").noneMatch { it.startsWith("DEDUPLICATE_TOKENS") }
+        assertThat(variants.first { it.name == "variant_ringbuffer_dedup" }.defines)
+            .containsAll(reference).contains("RINGBUFFER", "DEDUPLICATE_TOKENS=1")
+        assertThat(variants.first { it.name == "variant_single_token" }.defines)
+            .contains("SINGLE_TOKEN=1").doesNotContain("SINGLE_TOKEN=0")
+    }
+
+    @Test
+    fun clockHistoryRulesOutTimestamps() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+                clock x : int
+                history x(2)
+
+                m -> m :: a ==> h_x_2 < 3
+            }
+            """
+        )
+        val variants = MonitorPlan(contract).engineVariants()
+        assertThat(variants.map { it.name }).doesNotContain("variant_timestamp_clocks")
+        //out of bounds history is a violation with ERROR_TRACE_ACCESS, so those variants have a reference of their own
+        assertThat(variants.associate { it.name to it.reference }).containsEntry(
+            "variant_noexcept_trace_access", "variant_reference"
+        ).containsEntry("variant_error_trace_access", null).containsEntry(
+            "variant_error_noexcept_trace_access", "variant_error_trace_access"
+        )
+    }
+
+    @Test
+    fun prunedMonitorHasNoFuzzyVariant() {
+        val contract = load(
+            """
+            contract C {
+                input a : bool
+
+                m -> m :: a ==> true
+                m -> m :: a & !a ==> true
+            }
+            """
+        )
+        val pruned = contract.pruned()
+        assertThat(pruned).isNotSameAs(contract)
+        assertThat(MonitorPlan(pruned, MonitorOptions(pruned = true)).engineVariants().map { it.name })
+            .doesNotContain("variant_fuzzy")
+        assertThat(MonitorPlan(contract).engineVariants().map { it.name }).contains("variant_fuzzy")
+    }
+}
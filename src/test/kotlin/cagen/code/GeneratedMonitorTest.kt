@@ -0,0 +1,181 @@
+package cagen.code
+
+import cagen.Rca
+import cagen.Tool
+import com.github.ajalt.clikt.core.parse
+import com.github.ajalt.clikt.core.subcommands
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Assumptions.assumeTrue
+import org.junit.jupiter.api.BeforeEach
+import org.junit.jupiter.api.Test
+import org.junit.jupiter.api.io.TempDir
+import java.nio.file.Path
+import java.util.concurrent.TimeUnit
+import kotlin.io.path.div
+import kotlin.io.path.readText
+import kotlin.io.path.writeText
+
+/**
+ * Builds monitors generated by `cagen rca` with g++ and runs them on traces, skipped without a C++ compiler.
+ */
+class GeneratedMonitorTest {
+    @TempDir
+    lateinit var folder: Path
+
+    @BeforeEach
+    fun compilerAvailable() {
+        assumeTrue(runCatching { ProcessBuilder("g++", "--version").start().waitFor() == 0 }.getOrDefault(false))
+    }
+
+    private fun generate(system: String) {
+        val file = folder / "System.sys"
+        file.writeText(system.trimIndent())
+        Tool().subcommands(Rca()).parse(listOf("rca", "-o", folder.toString(), file.toString()))
+    }
+
+    //output of command, which has to stop in time and succeed
+    private fun run(vararg command: String): String {
+        val output = folder / "output.txt"
+        val process = ProcessBuilder(*command).directory(folder.toFile())
+            .redirectErrorStream(true).redirectOutput(output.toFile()).start()
+        if (!process.waitFor(60, TimeUnit.SECONDS)) {
+            process.destroyForcibly()
+            error("${command.joinToString(" ")} did not stop:\n${output.readText()}")
+        }
+        assertThat(process.exitValue()).describedAs(output.readText()).isZero()
+        return output.readText()
+    }
+
+    private fun build(contract: String, binary: String, vararg defines: String) = run(
+        "g++", "-std=c++17", "-O1", "-pthread", "-DDISPLAY_TRACES=1", "-DMONITOR_RATE=0",
+        *defines.map { "-D$it" }.toTypedArray(), "-o", binary, "$contract.cpp", "${contract}_monitor.cpp"
+    )
+
+    private fun trace(name: String, vararg lines: String) =
+        (folder / name).writeText(lines.joinToString("\n", postfix = "\n"))
+
+    @Test
+    fun parallelTokensFollowTheSequentialRun() {
+        generate(
+            """
+            contract Fork {
+                input a : bool
+                input stop : bool
+                clock x : int
+
+                idle -> idle :: !stop ==> true
+                idle -> Busy :: a & !stop ==> true # x
+                Busy -> Busy :: !stop ==> x < 5
+            }
+
+            reactor Forks {
+                input a, stop : bool
+                contract Fork
+
+                {=
+                =}
+            }
+            """
+        )
+        //every step forks a token, the oldest ones die once x reaches 5, so several tokens are live until stop
+        val steps = Array(12) { "t_e=1,t_s=0,a=1,stop=0" } + "t_e=1,t_s=0,a=0,stop=1"
+        trace("fork.txt", *steps)
+        build("Fork", "sequential")
+        build("Fork", "parallel", "PARALLEL_TOKENS=2", "PARALLEL_THRESHOLD=2")
+        val sequential = run("./sequential", "fork.txt")
+        assertThat(sequential).contains("(ENVIRONMENT LOSES)")
+        assertThat(run("./parallel", "fork.txt")).isEqualTo(sequential)
+    }
+
+    @Test
+    fun offlineCheckAgreesWithTheOnlineRun() {
+        generate(
+            """
+            contract Toggle {
+                input a : bool
+                output b : bool
+
+                off -> On :: a ==> b
+                off -> off :: !a ==> !b
+                On -> On :: true ==> b
+                On -> off :: !a ==> true
+            }
+
+            reactor Toggles {
+                input a : bool
+                output b : bool
+                contract Toggle
+
+                {=
+                    b = a;
+                =}
+            }
+            """
+        )
+        //step 11 is in the third block of four lines, the steps after it are never reached
+        trace(
+            "toggle.txt",
+            "t_e=1,t_s=0,a=0,b=0",
+            "t_e=1,t_s=0,a=1,b=1",
+            "t_e=1,t_s=0,a=1,b=1,repeat=3",
+            "t_e=1,t_s=0,a=0,b=1",
+            "t_e=1,t_s=0,a=0,b=0",
+            "t_e=1,t_s=0,a=0,b=0",
+            "t_e=1,t_s=0,a=1,b=1",
+            "t_e=1,t_s=0,a=1,b=1",
+            "t_e=1,t_s=0,a=1,b=0",
+            "t_e=1,t_s=0,a=0,b=0",
+            "t_e=1,t_s=0,a=1,b=1",
+        )
+        build("Toggle", "toggle", "OFFLINE_BLOCK=4", "OFFLINE_THREADS=2")
+        val online = run("./toggle", "toggle.txt")
+        assertThat(online).contains("(SYSTEM LOSES)")
+        //the online run prints the number of steps so far before it reads a line
+        val step = Regex("""-+ \[(\d+)]""").findAll(online).last().groupValues[1]
+        assertThat(step).isEqualTo("11")
+        assertThat(run("./toggle", "toggle.txt", "--offline").trim()).isEqualTo("SYSTEM LOSES at step $step")
+    }
+
+    @Test
+    fun profileCountsTheTransitionsOfAClocklessContract() {
+        generate(
+            """
+            contract Toggle {
+                input a : bool
+                output b : bool
+
+                off -> On :: a ==> b
+                off -> off :: !a ==> !b
+                On -> On :: true ==> b
+                On -> off :: !a ==> true
+            }
+
+            reactor Toggles {
+                input a : bool
+                output b : bool
+                contract Toggle
+
+                {=
+                    b = a;
+                =}
+            }
+            """
+        )
+        //the repeated line keeps the On self-loop stationary, which the default engines would not count
+        trace(
+            "toggle.txt",
+            "t_e=1,t_s=0,a=0,b=0",
+            "t_e=1,t_s=0,a=1,b=1",
+            "t_e=1,t_s=0,a=1,b=1,repeat=5",
+            "t_e=1,t_s=0,a=0,b=1",
+            "t_e=1,t_s=0,a=0,b=0",
+        )
+        build("Toggle", "toggle", "PROFILE_MONITOR=1")
+        run("./toggle", "toggle.txt")
+        val fired = (folder / "Toggle.profile").readText().lines()
+            .filter { it.isNotBlank() && !it.startsWith("#") }
+            .map { it.split(" ")[5].toLong() }
+        assertThat(fired).hasSize(4).allMatch { it > 0 }
+        assertThat(fired[2]).isGreaterThanOrEqualTo(6)
+    }
+}
@@ -0,0 +1,42 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class GuardSolverTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input leak : bool
+                input level : int
+                output shutoff : bool
+                clock timer : int
+
+                Leaking -> Leaking :: leak ==> timer < 10
+                Leaking -> not_Leaking :: ! leak ==> timer < 10 # timer
+                not_Leaking -> not_Leaking :: level < 5 ==> true
+                not_Leaking -> Leaking :: level >= 5 ==> timer >= 30 # timer
+                run -> run :: leak ==> timer <= 10
+                run -> Unsafe :: leak ==> shutoff # timer
+                Unsafe -> Unsafe :: leak & timer - level > 3 ==> shutoff
+                Unsafe -> run :: level + 3 >= timer ==> ! shutoff # timer
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    @Test
+    fun deterministicModes() {
+        assertThat(contract.deterministicModes()).containsExactlyInAnyOrder("Leaking", "not_Leaking", "Unsafe")
+    }
+
+    @Test
+    fun differenceConstraints() {
+        val unsafe = contract.transitions.filter { it.from == "Unsafe" }.map { it.contract.pre }
+        assertThat(contract.jointlySatisfiable(unsafe)).isFalse()
+        assertThat(contract.jointlySatisfiable(unsafe.take(1))).isTrue()
+    }
+}
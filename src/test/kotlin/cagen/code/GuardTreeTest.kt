@@ -0,0 +1,52 @@
+package cagen.code
+
+import cagen.ParserFacade
+import cagen.expr.SLiteral
+import cagen.expr.SVariable
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class GuardTreeTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input a : bool
+                input d : int
+                clock x : int
+
+                m -> m :: a & d > 2 ==> x < 3
+                m -> n :: !a ==> x < 3
+                m -> n :: a ==> true
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    private val guards = contract.transitions.map { it.contract.pre to it.contract.post }
+
+    private fun GuardTree.leaf(vararg path: Boolean): GuardTree.Leaf =
+        path.fold(this) { node, value -> (node as GuardTree.Branch).let { if (value) it.then else it.otherwise } }
+            as GuardTree.Leaf
+
+    @Test
+    fun sharedAtomsAreTestedOnce() {
+        val tree = guardTree(guards)!!
+        assertThat((tree as GuardTree.Branch).atom.atomicPredicates()).containsExactly("a")
+        //a, d > 2, x < 3
+        assertThat(tree.leaf(true, true, true)).isEqualTo(GuardTree.Leaf(listOf(0, 2), listOf(0, 2)))
+        assertThat(tree.leaf(true, true, false)).isEqualTo(GuardTree.Leaf(listOf(0, 2), listOf(2)))
+        assertThat(tree.leaf(true, false)).isEqualTo(GuardTree.Leaf(listOf(2), listOf(2)))
+        //!a, x < 3
+        assertThat(tree.leaf(false, true)).isEqualTo(GuardTree.Leaf(listOf(1), listOf(1)))
+        assertThat(tree.leaf(false, false)).isEqualTo(GuardTree.Leaf(listOf(1), listOf()))
+    }
+
+    @Test
+    fun tooManyAtoms() {
+        val many = (0 until 7).map { SVariable("v$it") to SLiteral.TRUE }
+        assertThat(guardTree(many.take(6))).isNotNull()
+        assertThat(guardTree(many)).isNull()
+    }
+}
@@ -0,0 +1,69 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.assertj.core.api.Assertions.assertThatThrownBy
+import org.junit.jupiter.api.Test
+
+class ProfileTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input a : bool
+
+                m -> m :: a ==> true
+                m -> n :: !a ==> true
+                m -> n :: true ==> a
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    private val profile = MonitorProfile.parse(
+        """
+        # contract transitions index visits enabled fired
+        C 3 0 100 5 5
+        C 3 1 100 60 60
+        C 3 1 100 35 35
+        Other 5 2 100 100 100
+        """.trimIndent().lines()
+    )
+
+    @Test
+    fun countsOfRunsAreAdded() {
+        assertThat(profile.counts(contract, contract.transitions[1])).isEqualTo(TransitionCounts(200, 95, 95))
+        assertThat(profile.counts(contract, contract.transitions[2])).isNull()
+    }
+
+    @Test
+    fun mostFrequentlyFiredFirst() {
+        val (t0, t1, t2) = contract.transitions
+        assertThat(profile.order(contract, contract.transitions)).containsExactly(t1, t0, t2)
+    }
+
+    @Test
+    fun biasedPreconditions() {
+        assertThat(profile.likely(contract, contract.transitions[0])).isFalse()
+        assertThat(profile.likely(contract, contract.transitions[1])).isNull()
+        assertThat(profile.likely(contract, contract.transitions[2])).isNull()
+    }
+
+    @Test
+    fun treeBranchesFollowLikelyTransitions() {
+        val tree = guardTree(contract.transitions.map { it.contract.pre to it.contract.post }) as GuardTree.Branch
+        val likelyNegation = MonitorProfile.parse(listOf("C 3 1 100 95 95"))
+        assertThat(likelyNegation.likely(contract, contract.transitions, tree)).isFalse()
+        assertThat(profile.likely(contract, contract.transitions, tree)).isNull()
+    }
+
+    @Test
+    fun profileOfDifferentlyPrunedMonitorIsRejected() {
+        val pruned = contract.copy(transitions = contract.transitions.take(2))
+        assertThatThrownBy { profile.counts(pruned, pruned.transitions[0]) }
+            .isInstanceOf(IllegalArgumentException::class.java)
+        assertThatThrownBy { MonitorProfile.parse(listOf("C 3 0 1 1 1", "C 2 0 1 1 1")) }
+            .isInstanceOf(IllegalArgumentException::class.java)
+    }
+}
@@ -0,0 +1,49 @@
+package cagen.code
+
+import cagen.ParserFacade
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class PruningTest {
+    private val contract = ParserFacade.loadFile(
+        CharStreams.fromString(
+            """
+            contract C {
+                input a : bool
+                input d : int8
+                input n : int
+                clock x : int
+
+                m -> m :: a ==> x < 3
+                m -> m :: a ==> x < 3
+                m -> P :: a & !a ==> true
+                m -> Q :: d > 200 ==> true
+                m -> R :: x < 0 ==> true
+                m -> S :: n > LIMIT & n < 3 ==> true
+                m -> Ok :: n > 1 ==> true
+                Dead -> Ok :: true ==> true
+                Ok -> m :: true ==> true # x
+            }
+            """.trimIndent()
+        )
+    ).contracts.first()
+
+    private val transitions = contract.transitions
+
+    @Test
+    fun unsatisfiablePreconditions() {
+        assertThat(transitions.map { contract.neverEnabled(it) })
+            .containsExactly(false, false, true, true, true, false, false, false, false)
+        assertThat(contract.neverEnabled(transitions[5], mapOf("LIMIT" to 5L))).isTrue()
+        assertThat(contract.neverEnabled(transitions[5], mapOf("LIMIT" to 1L))).isFalse()
+    }
+
+    @Test
+    fun deadTransitionsAndModesAreRemoved() {
+        val pruned = contract.pruned(mapOf("LIMIT" to 5L))
+        assertThat(pruned.transitions).containsExactly(transitions[0], transitions[6], transitions[8])
+        assertThat(pruned.states).containsExactlyInAnyOrder("m", "Ok")
+        assertThat(transitions[5].contract.pre.variableNames()).contains("LIMIT")
+    }
+}
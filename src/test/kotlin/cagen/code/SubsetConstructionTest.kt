@@ -0,0 +1,57 @@
+package cagen.code
+
+import cagen.ParserFacade
+import cagen.code.CCodeUtilsSimplified.toCExpr
+import org.antlr.v4.runtime.CharStreams
+import org.assertj.core.api.Assertions.assertThat
+import org.junit.jupiter.api.Test
+
+class SubsetConstructionTest {
+    private fun load(code: String) = ParserFacade.loadFile(CharStreams.fromString(code.trimIndent())).contracts.first()
+
+    private val contract = load(
+        """
+        contract C {
+            input a : bool
+            input b : bool
+
+            m -> m :: true ==> !b
+            m -> Next :: a ==> true
+            Next -> Next :: b ==> true
+        }
+        """
+    )
+
+    @Test
+    fun determinisedMarkings() {
+        val dfa = contract.markingDfa(1 shl 16)!!
+        assertThat(dfa.predicates.map { it.toCExpr() }).containsExactly("b", "a")
+        //{m}, {Next}, {m, Next} and the two sinks
+        assertThat(dfa.size).isEqualTo(5)
+
+        val b = 1
+        val a = 2
+        fun run(vararg vectors: Int) = dfa.verdicts[vectors.fold(0) { state, v -> dfa.next[state][v] }]
+        assertThat(run(0, 0)).isEqualTo(Verdict.NONE)
+        assertThat(run(b)).isEqualTo(Verdict.SYSTEM_LOSES)
+        assertThat(run(a, b)).isEqualTo(Verdict.NONE)
+        assertThat(run(a or b, 0)).isEqualTo(Verdict.ENVIRONMENT_LOSES)
+        assertThat(run(a or b, 0, b)).isEqualTo(Verdict.ENVIRONMENT_LOSES)
+    }
+
+    @Test
+    fun fallbackToTokens() {
+        assertThat(contract.markingDfa(8)).isNull()
+        val timed = load(
+            """
+            contract T {
+                input a : bool
+                clock x : int
+
+                m -> m :: a ==> x < 3
+            }
+            """
+        )
+        assertThat(timed.markingDfa(1 shl 16)).isNull()
+    }
+}